@@ -1,32 +1,720 @@
+#define _POSIX_C_SOURCE 200809L
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 #include "stdio.h"
 #include "string.h"
 #include "stdlib.h"
+#include "time.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "math.h"
+#include "stddef.h"
+#include "errno.h"
+#include "pthread.h"
 
     #define DEBUG
 
 const uint32_t windowSize[2] = {800, 600};
+uint32_t framebufferResized = 0; // set by the glfw callback, cleared once the swapchain has been rebuilt
+uint32_t instanceApiVersion = VK_API_VERSION_1_2; // what initVulkan asked for, devices are used at the lower of it and their own
 const uint32_t queuesNeeded = VK_QUEUE_GRAPHICS_BIT ;
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily; // transfer only family, graphicsFamily when there is none
+    uint32_t computeFamily;  // compute without graphics, graphicsFamily when there is none
     uint32_t Flags;
     uint32_t presentFlag;
 };
+// queues sharing a family are the same VkQueue
 struct qHandles {
     VkQueue graphics;
     VkQueue present;
+    VkQueue transfer;
+    VkQueue compute;
+    uint32_t graphicsFamily;
+    uint32_t presentFamily;
+    uint32_t transferFamily;
+    uint32_t computeFamily;
 };
 struct sChainImgInfo {
     uint32_t swapChainImageCount;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
+    VkImageLayout finalLayout; // layout the render pass leaves the image in
+    VkPresentModeKHR presentMode; // what the surface actually granted
 };
 struct fileData {
-    unsigned char* code;
-    uint32_t codeSize;
+    const uint32_t* code;
+    size_t codeSize;
+    size_t mapSize; // non zero when code points into an mmap'd file
+};
+
+#define SPIRV_MAGIC 0x07230203u
+#ifdef EMBED_SHADERS
+// spir-v pulled into .rodata at compile time, 4 byte aligned so it can be handed to vulkan as is
+#define EMBED_SPIRV(symbol, file) \
+    __asm__(".section .rodata\n.balign 4\n" #symbol ":\n.incbin \"" file "\"\n" #symbol "End:\n.previous\n"); \
+    extern const uint32_t symbol[] __asm__(#symbol); \
+    extern const unsigned char symbol##End[] __asm__(#symbol "End");
+EMBED_SPIRV(embeddedVertSpv, "shaders/vert.spv")
+EMBED_SPIRV(embeddedFragSpv, "shaders/frag.spv")
+EMBED_SPIRV(embeddedCullSpv, "shaders/cull.spv")
+EMBED_SPIRV(embeddedReduceSpv, "shaders/reduce.spv")
+EMBED_SPIRV(embeddedDrawSpv, "shaders/draw.spv")
+EMBED_SPIRV(embeddedDrawUniformSpv, "shaders/draw_uniform.spv")
+struct embeddedShader {
+    const char* fileName;
+    const uint32_t* code;
+    const unsigned char* end;
+};
+const struct embeddedShader embeddedShaders[] = {
+    {"shaders/vert.spv", embeddedVertSpv, embeddedVertSpvEnd},
+    {"shaders/frag.spv", embeddedFragSpv, embeddedFragSpvEnd},
+    {"shaders/cull.spv", embeddedCullSpv, embeddedCullSpvEnd},
+    {"shaders/reduce.spv", embeddedReduceSpv, embeddedReduceSpvEnd},
+    {"shaders/draw.spv", embeddedDrawSpv, embeddedDrawSpvEnd},
+    {"shaders/draw_uniform.spv", embeddedDrawUniformSpv, embeddedDrawUniformSpvEnd}
+};
+#endif
+
+#define ALLOCATOR_BLOCK_SIZE (64ull << 20) // VkDeviceMemory size sub-allocated from, smaller on small heaps
+#define ALLOCATOR_MIN_SIZE 256ull          // smallest buddy
+#define FRAME_ARENA_SIZE (4ull << 20)
+// one VkDeviceMemory, either split with a buddy tree or owned by a single dedicated allocation
+struct memBlock {
+    VkDeviceMemory memory; // VK_NULL_HANDLE once a dedicated block is released, the slot is reused
+    VkDeviceSize size;
+    uint32_t memoryType;
+    uint32_t linear;       // buffers and optimal images never share a block so bufferImageGranularity never applies
+    uint32_t levels;       // depth of the buddy tree, 0 for dedicated blocks
+    uint8_t* longest;      // per tree node the order + 1 of the largest free buddy below it, 0 when full
+    void* mapped;          // whole block mapped once when host visible
+    VkDeviceSize used;
+    uint32_t allocationCount;
+};
+struct gpuAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;     // reserved size, the request rounded up to its buddy
+    void* mapped;          // NULL unless the memory is host visible
+    uint32_t block;
+    uint32_t order;
+};
+struct gpuAllocator {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memProps;
+    uint32_t maxAllocations; // maxMemoryAllocationCount
+    uint32_t memoryCount;    // live VkDeviceMemory objects
+    struct memBlock* blocks;
+    uint32_t blockCount;
+    uint64_t allocationCount;
+    VkDeviceSize requested;  // bytes asked for before rounding, to report internal fragmentation
+};
+struct allocatorStats {
+    uint32_t deviceMemoryCount;
+    uint64_t allocationCount;
+    VkDeviceSize reserved;   // bytes of VkDeviceMemory
+    VkDeviceSize used;       // bytes handed out including buddy rounding
+    VkDeviceSize requested;
+    VkDeviceSize largestFree;
+    double fragmentation;    // 1 - largest free range / free bytes
+};
+// bump allocator over one persistently mapped buffer, reset as a whole once the gpu is done with it
+struct linearArena {
+    VkBuffer buffer;
+    struct gpuAllocation allocation;
+    VkDeviceSize capacity;
+    VkDeviceSize head;
+    VkDeviceSize peak;
+};
+
+struct vertex {
+    float pos[2];
+    float color[3];
+};
+// cpu side geometry, indices are always 32 bit here and narrowed on upload
+struct meshData {
+    struct vertex* vertices;
+    uint32_t* indices;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+#define VERTEX_LAYOUT_INTERLEAVED 0
+#define VERTEX_LAYOUT_SPLIT 1 // positions in their own stream, so position-only passes fetch less
+#define MAX_VERTEX_STREAMS 2
+#define MAX_GRID_SIZE 4096
+#define VERTEX_CACHE_SIZE 32 // lru size the index order is optimized for
+#define FIFO_CACHE_SIZE 16   // fifo size used to report the miss ratio, close to what gpus actually have
+struct mesh {
+    VkBuffer vertexBuffer; // every stream lives in this one buffer
+    struct gpuAllocation vertexMemory;
+    VkBuffer indexBuffer;
+    struct gpuAllocation indexMemory;
+    VkDeviceSize streamOffsets[MAX_VERTEX_STREAMS];
+    uint32_t streamCount;
+    VkIndexType indexType;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+};
+
+#define MAX_FRAMES_IN_FLIGHT 3
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+#define MAX_INSTANCE_COUNT (1u << 24)
+#define INSTANCE_WOBBLE_STEPS 64
+#define STORAGE_OFFSET_ALIGNMENT 256 // largest minStorageBufferOffsetAlignment the spec allows
+struct instanceData {
+    float transform[3]; // xy offset, z uniform scale
+    float color[3];
+};
+#define DRAW_DATA_INSTANCED 0 // per-instance vertex stream read from the instance ring
+#define DRAW_DATA_PUSH 1      // one vkCmdDrawIndexed per object with its drawConstants pushed right before
+#define DRAW_DATA_UNIFORM 2   // the same, with drawConstants in the frame's arena at a dynamic offset, for when they do not fit in push constants
+// per-draw payload of draw.vert and draw_uniform.vert, laid out the same in push constant and std140 blocks
+struct drawConstants {
+    float transform[3]; // xy offset, z uniform scale
+    uint32_t objectId;  // index of the draw, not read by the bundled shaders
+    float color[4];
+};
+// persistently mapped, one slice per frame in flight so the cpu never writes what the gpu is reading
+struct instanceRing {
+    VkBuffer buffer;
+    struct gpuAllocation allocation;
+    uint32_t instanceCount;
+    VkDeviceSize sliceSize;
+    struct instanceData* base; // resting layout the per-frame animation starts from
+    float wobble[INSTANCE_WOBBLE_STEPS];
+    uint32_t drawCount[MAX_FRAMES_IN_FLIGHT]; // instances written to each slice, fewer than instanceCount when culled on the cpu
+    struct instanceData* host; // written instead of the slice when drawn with per-draw data, NULL otherwise
+};
+
+#define CULL_MODE_OFF 0
+#define CULL_MODE_CPU 1 // visible instances are compacted into the instance ring
+#define CULL_MODE_GPU 2 // a compute pass writes one indirect draw per object
+#define CULL_GROUP_SIZE 64 // local_size_x of cull.comp
+#define CULL_PAN_PERIOD 600 // frames for the instance field to scroll across the screen and back while culling
+// matches the push constant block of cull.comp
+struct cullPush {
+    float clipRect[4];
+    uint32_t objectCount;
+    uint32_t indexCount;
+    float meshRadius;
+};
+
+#define COMPUTE_MAX_BINDINGS 8
+#define COMPUTE_STAGING_SIZE (4ull << 20) // uploads and readbacks larger than this go in pieces
+// what a kernel's binding points at, buffer range for storage buffers or view for storage images
+struct computeBinding {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+    VkImageView view; // in VK_IMAGE_LAYOUT_GENERAL while dispatched
+};
+// compute pipeline with one descriptor set layout, bindings numbered in order
+struct computeKernel {
+    VkDevice device;
+    VkDescriptorSetLayout setLayout; // owned by the descriptor cache
+    VkDescriptorPool descriptorPool; // maxSets sets, released with the kernel
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorType types[COMPUTE_MAX_BINDINGS]; // VK_DESCRIPTOR_TYPE_STORAGE_BUFFER or VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+    uint32_t bindingCount;
+    uint32_t pushSize; // bytes of the push constant block, 0 without one
+};
+struct gpuCuller {
+    struct computeKernel kernel; // cull.comp, instances, draws and count as storage buffers 0 to 2
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT]; // one per frame slot, each points at that slot's slices
+    VkBuffer drawBuffer;   // VkDrawIndexedIndirectCommand per object, one slice per frame in flight
+    struct gpuAllocation drawMemory;
+    VkDeviceSize drawSlice;
+    VkBuffer countBuffer;  // visible objects per slot, host visible so it can be reported
+    struct gpuAllocation countMemory;
+    uint32_t maxDrawCount; // maxDrawIndirectCount, larger batches are split
+    struct cullPush push;
+    uint32_t graphicsFamily;
+    uint32_t computeFamily; // differs from graphicsFamily when culling runs on the async compute queue
+};
+// runs kernels outside the frame loop, each submission goes to the compute queue alone and is waited on through the compute timeline
+// buffers it touches stay exclusive to the compute family
+struct computeContext {
+    struct gpuAllocator* allocator;
+    struct syncLayer* sync;
+    VkCommandPool pool;
+    VkBuffer staging; // host visible, shared by uploads and readbacks
+    struct gpuAllocation stagingMemory;
+    VkQueryPool queryPool; // VK_NULL_HANDLE when the compute family has no timestamps, runs are timed on the cpu then
+    double msPerTick;
+    uint64_t validMask;
+};
+#define REDUCE_GROUP_SIZE 256 // local_size_x of reduce.comp
+#define REDUCE_GROUPS 1024    // workgroups of the reduction, each loops over its share of the input
+#define REDUCE_RUNS 10        // timed runs after a warmup, the fastest is reported
+#define MAX_COMPUTE_BENCH_MB 4096
+// matches the push constant block of reduce.comp
+struct reducePush {
+    uint32_t count; // uvec4 elements to sum
+};
+
+// what the render pass draws, shared by the inline and the threaded recording paths
+struct drawList {
+    struct mesh* mesh;
+    struct instanceRing* instances;
+    struct gpuCuller* culler; // NULL unless culling on the gpu
+    uint32_t separateDraws;   // one vkCmdDrawIndexed per instance instead of one instanced draw
+    VkPipelineLayout layout;
+    struct frameDescriptors* descriptors; // set 0
+    struct bindlessTable* bindless;       // set 1, NULL unless bindless
+    uint32_t drawData;                    // DRAW_DATA_*
+    struct frameDescriptors* drawUniforms; // set 2 with DRAW_DATA_UNIFORM, offsets hold where each slot's first drawConstants is
+};
+
+#define MAX_RECORD_THREADS 8
+// one frame's worth of work handed to every recording thread
+struct recordJob {
+    VkRenderPass renderPass;   // VK_NULL_HANDLE with dynamic rendering
+    VkFramebuffer framebuffer;
+    VkFormat colorFormat;      // inherited instead of the render pass with dynamic rendering
+    VkExtent2D extent;
+    VkPipeline pipeline;
+    struct drawList* draws;
+    uint32_t frameSlot;
+    uint32_t drawCount;
+};
+struct recordPool;
+struct recordWorker {
+    pthread_t thread;
+    struct recordPool* pool;
+    uint32_t index;
+    VkCommandPool commandPools[MAX_FRAMES_IN_FLIGHT]; // reset whole once the frame slot's timeline value is reached
+    VkCommandBuffer secondary[MAX_FRAMES_IN_FLIGHT];
+    int result;
+};
+struct recordPool {
+    VkDevice device;
+    uint32_t threadCount;
+    uint32_t frameCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation; // bumped for every job so workers can tell a new one from a spurious wakeup
+    uint32_t pending;
+    uint32_t quit;
+    struct recordJob job;
+    struct recordWorker workers[MAX_RECORD_THREADS];
+};
+
+#define PIPELINE_REGISTRY_SIZE 64
+#define PIPELINE_BATCH_SIZE 8       // create infos handed to one vkCreateGraphicsPipelines
+#define MAX_PIPELINE_THREADS 8
+#define DEFAULT_PIPELINE_THREADS 2
+#define PIPELINE_SHADER_NAME_SIZE 32
+#define PIPELINE_VARIANT_FRAME 60   // frame of the measured run at which --pipeline-variants asks for its pipelines
+#define PIPELINE_MAX_MODULES 8
+#define PIPELINE_PENDING 0
+#define PIPELINE_READY 1
+#define PIPELINE_FAILED 2
+// specialization constants of the scene's vertex shaders, the index is the constant_id
+#define SPEC_COLOR_MODE 0
+#define SPEC_TINT 1
+#define PIPELINE_SPEC_CONSTANTS 2
+#define COLOR_MODE_SHADED 0 // vertex color times object color
+#define COLOR_MODE_OBJECT 1
+#define COLOR_MODE_VERTEX 2
+// the whole state a graphics pipeline is built from, hashed and compared bytewise
+// start from pipelineDescDefault and copy with memcpy, assignment need not carry the zeroed padding
+struct pipelineDesc {
+    char vertexShader[PIPELINE_SHADER_NAME_SIZE];
+    char fragmentShader[PIPELINE_SHADER_NAME_SIZE];
+    uint32_t vertexLayout; // VERTEX_LAYOUT_*
+    uint32_t drawData;     // DRAW_DATA_*
+    VkPrimitiveTopology topology;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkBool32 blendEnable;  // alpha blending
+    VkFormat colorFormat;  // only read with dynamic rendering
+    VkRenderPass renderPass; // VK_NULL_HANDLE with dynamic rendering
+    VkPipelineLayout layout;
+    uint32_t specialization[PIPELINE_SPEC_CONSTANTS]; // value of each constant_id in both stages, booleans as VkBool32
+};
+// everything a VkGraphicsPipelineCreateInfo points to, kept alive until vkCreateGraphicsPipelines returns
+struct pipelineBuild {
+    VkSpecializationMapEntry specEntries[PIPELINE_SPEC_CONSTANTS];
+    VkSpecializationInfo specInfo;
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    VkPipelineDynamicStateCreateInfo dynamicStateCreate;
+    VkPipelineVertexInputStateCreateInfo vertexCreateInfo;
+    VkPipelineInputAssemblyStateCreateInfo inputCreateInfo;
+    VkPipelineViewportStateCreateInfo viewPortCreateInfo;
+    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo;
+    VkPipelineMultisampleStateCreateInfo multiCreateInfo;
+    VkPipelineColorBlendAttachmentState colorBlendAttachment;
+    VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo;
+    VkPipelineRenderingCreateInfo renderingCreateInfo;
+    VkGraphicsPipelineCreateInfo info;
+};
+struct pipelineEntry {
+    struct pipelineDesc desc; // never changes once stored
+    uint64_t hash;
+    uint32_t state;           // PIPELINE_*
+    VkPipeline pipeline;      // VK_NULL_HANDLE until PIPELINE_READY
+    double requestMs, readyMs;
+};
+// one module per spir-v file, shared by every variant specialized from it
+struct pipelineModule {
+    char name[PIPELINE_SHADER_NAME_SIZE];
+    VkShaderModule module;
+};
+// pipelines by description, compiled on worker threads so asking for one never stalls the caller
+struct pipelineRegistry {
+    VkDevice device;
+    VkPipelineCache cache;
+    pthread_t threads[MAX_PIPELINE_THREADS];
+    uint32_t threadCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // new requests for the threads
+    uint32_t quit;
+    struct pipelineEntry entries[PIPELINE_REGISTRY_SIZE];
+    uint32_t count;
+    uint32_t claimed;    // entries taken by a thread so far, they are compiled in request order
+    struct pipelineModule modules[PIPELINE_MAX_MODULES];
+    uint32_t moduleCount;
+    uint64_t requests, hits;
+    uint32_t compiled, failed, batches;
+    double compileMs, maxBatchMs; // thread time inside pipelineCompileBatch
+};
+
+// transient pool reset in one call per frame, buffers allocated in earlier frames are handed out again
+struct commandAllocator {
+    VkCommandPool pool;
+    VkCommandBuffer* buffers; // every buffer allocated from pool so far
+    uint32_t capacity;
+    uint32_t used;            // handed out since the last reset
+    uint32_t allocatedThisFrame;
+    uint32_t recycledThisFrame;
+    uint64_t allocatedTotal;
+    uint64_t recycledTotal;
+};
+
+// everything a recorded frame depends on besides the swapchain image and frame slot, compared bytewise
+struct commandCacheKey {
+    VkImageView attachment; // rebuilt together with the framebuffer, so it stands for both paths
+    VkRenderPass renderPass;
+    VkPipeline pipeline;
+    VkExtent2D extent;
+    uint32_t drawCount;
+    uint64_t sceneVersion;
+};
+struct commandCacheEntry {
+    struct commandCacheKey key;
+    VkCommandBuffer commandBuffer; // VK_NULL_HANDLE until first recorded
+};
+// primaries recorded once per swapchain image and frame slot and resubmitted while their key still matches
+struct commandCache {
+    VkCommandPool pool;
+    struct commandCacheEntry* entries; // imageCount * frameCount, by image then frame slot
+    uint32_t imageCount;
+    uint32_t frameCount;
+    uint64_t sceneVersion; // bumped by commandCacheInvalidate
+    uint64_t hits;
+    uint64_t misses;
+};
+
+// VK_KHR_dynamic_rendering, core in 1.3, draws straight into image views without a render pass or framebuffers
+struct dynamicRendering {
+    PFN_vkCmdBeginRenderingKHR begin; // core or KHR entry point
+    PFN_vkCmdEndRenderingKHR end;
+};
+
+struct presentModeName {
+    const char* name;
+    VkPresentModeKHR mode;
+};
+const struct presentModeName presentModeNames[] = {
+    {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+    {"fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+    {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+    {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR}
+};
+#define PRESENT_MODE_COUNT (sizeof(presentModeNames) / sizeof(presentModeNames[0]))
+
+#define PRESENT_HISTORY 16 // presents tracked at once, more than any swapchain queues
+#define PRESENT_WAIT_SLICE_NS 1000000ull // longest a swapchain rebuild has to wait for the waiter thread
+// a thread waits on each present id with VK_KHR_present_wait and times input sampling to display
+struct presentLatency {
+    PFN_vkWaitForPresentKHR waitForPresent; // NULL when VK_KHR_present_wait is not enabled
+    VkDevice device;
+    VkSwapchainKHR swapChain; // swapped under waitLock when the swapchain is rebuilt
+    pthread_t thread;
+    pthread_mutex_t waitLock; // held across each bounded wait and by the main thread around acquire, present and rebuild, the swapchain is externally synchronized
+    pthread_mutex_t mutex;    // everything below
+    pthread_cond_t wake;
+    uint64_t presentId; // last id handed out by presentLatencyBegin
+    uint64_t queuedId;  // last id handed to vkQueuePresentKHR, the thread sleeps until there is one it has not waited on
+    uint64_t waitedId;  // last id the thread is done with
+    uint64_t measureFrom; // ids below this are warmup and not kept
+    double sampleMs[PRESENT_HISTORY]; // input sampling time by id
+    double lastPresentMs; // when the newest measured image reached the display, 0 before the first
+    double* samples; // input to display latency of every measured frame
+    uint64_t sampleCount;
+    uint64_t sampleCapacity;
+    uint32_t quit;
+};
+
+#define PACING_MARGIN_MS 1.0 // slack between the predicted end of a frame and the vblank it aims for
+#define DEFAULT_REFRESH_RATE 60 // Hz, when GLFW cannot tell the monitor's
+// records each frame as late as possible while still making the next vblank
+struct framePacer {
+    double refreshMs; // from the monitor's video mode
+    double vblankMs;  // a past vblank the schedule is anchored to
+    double workMs;    // time from input sampling until the frame is done on the gpu, rises at once and decays slowly
+    double targetMs;  // vblank the last frame aimed for
+};
+
+#define SYNC_GRAPHICS 0
+#define SYNC_COMPUTE 1
+#define SYNC_TRANSFER 2
+#define SYNC_QUEUE_COUNT 3
+#define SYNC_MAX_WAITS 4
+// one timeline semaphore per queue, every submission signals the next value of its queue
+// the cpu polls or waits for a value and other queues wait on it directly, no per-frame fences
+struct queueTimeline {
+    VkQueue queue;
+    VkSemaphore semaphore;
+    uint64_t submitted; // value signaled by the newest submission
+    uint64_t completed; // last value read back, may lag behind the gpu
+};
+struct syncLayer {
+    VkDevice device;
+    struct queueTimeline timelines[SYNC_QUEUE_COUNT]; // SYNC_GRAPHICS, SYNC_COMPUTE, SYNC_TRANSFER
+    PFN_vkWaitSemaphoresKHR waitSemaphores; // core or KHR entry point, whichever the device exposes
+    PFN_vkGetSemaphoreCounterValueKHR counterValue;
+    uint64_t hostWaits; // waits that had to block
+};
+// what a single submission waits on, binary semaphores from the swapchain go in with a value of 0
+struct syncWaits {
+    VkSemaphore semaphores[SYNC_MAX_WAITS];
+    uint64_t values[SYNC_MAX_WAITS];
+    VkPipelineStageFlags stages[SYNC_MAX_WAITS];
+    uint32_t count;
+};
+
+// copies run on the transfer queue, the buffers are then handed over to the graphics family
+struct uploadContext {
+    struct qHandles* queues;
+    VkCommandPool transferPool;
+    VkCommandPool graphicsPool; // records the acquiring half of each ownership transfer
+    VkSemaphore released;       // transfer release -> graphics acquire
+};
+
+#define STREAM_RING_SIZE (16ull << 20)
+#define STREAM_BATCHES 8         // transfer submissions in flight before the stream waits for ring space
+#define STREAM_MAX_REGIONS 64    // regions merged into one vkCmdCopyBuffer
+#define STREAM_ALIGNMENT 16      // ring offset of every request, image requests are further aligned to their texel size
+#define DEFAULT_STREAM_BUDGET_KB 1024
+#define STREAM_SMALL_ASSET (4u << 10)   // --stream scenes are mostly small pieces
+#define STREAM_LARGE_ASSET (512u << 10) // with every eighth one large
+#define MAX_STREAM_MB 4096
+#define STREAM_TEXTURE_SIZE 256 // texels a side of the RGBA8 texture that goes with a --stream scene
+#define STREAM_MAX_ACQUIRES 16  // released images waiting for the graphics queue to acquire them
+#define STREAM_WAIT_STAGES (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+// a queued upload, copied into the ring piece by piece as the per-frame budget allows
+struct streamRequest {
+    VkBuffer buffer;          // VK_NULL_HANDLE for image requests
+    VkImage image;
+    VkExtent3D extent;
+    VkImageLayout finalLayout;
+    VkDeviceSize dstOffset;
+    VkDeviceSize alignment;   // ring offset alignment of image requests, a multiple of both the texel size and 4
+    const char* data;         // owned by the caller until the ticket completes
+    VkDeviceSize size;
+    VkDeviceSize done;        // bytes already copied into the ring, images always go in one piece
+    uint64_t ticket;
+};
+struct streamBatch {
+    VkCommandBuffer commandBuffer;
+    uint64_t value;           // transfer timeline value of the submission
+    uint64_t ringEnd;         // ring head after this batch, becomes the tail once it retires
+    uint64_t lastTicket;      // newest request whose last byte is in this or an earlier batch
+};
+// persistently mapped staging ring drained on the transfer queue, ring space is reclaimed as the batches' timeline values retire
+// buffer destinations must be concurrent with the graphics family, images are exclusive to it and handed over by streamRecordAcquires
+struct uploadStream {
+    VkDevice device;
+    struct syncLayer* sync;
+    uint32_t transferFamily, graphicsFamily;
+    VkCommandPool pool;
+    VkBuffer ring;
+    struct gpuAllocation ringMemory;
+    VkDeviceSize ringSize;
+    uint64_t head, tail;      // monotonic byte positions, the ring offset is modulo ringSize
+    VkDeviceSize bytesPerFrame; // copied per streamSubmit, 0 for no limit
+    struct streamBatch batches[STREAM_BATCHES]; // batch n lives in batches[n % STREAM_BATCHES]
+    uint64_t submitted;       // batches handed to the queue
+    uint64_t completed;       // batches retired, always the oldest ones
+    uint64_t nextTicket;
+    uint64_t submittedTicket;
+    uint64_t completedTicket;
+    struct streamRequest* requests;
+    uint32_t requestHead, requestCount, requestCapacity;
+    VkBufferCopy regions[STREAM_MAX_REGIONS]; // pending regions of the copy being merged
+    VkImageMemoryBarrier acquires[STREAM_MAX_ACQUIRES]; // images released by the transfer family, only used when it is not the graphics family
+    uint32_t acquireCount;
+    uint64_t acquireValue;    // transfer value of the newest batch releasing one of them
+    uint32_t regionCount;
+    VkBuffer regionDst;
+    uint64_t bytes, copyCommands, copyRegions, stalls; // stalls: submits cut short by a full ring or too many batches in flight
+    VkDeviceSize maxBatchBytes;
+};
+
+#define DESCRIPTOR_MAX_LAYOUTS 16
+#define DESCRIPTOR_MAX_BINDINGS COMPUTE_MAX_BINDINGS
+#define FRAME_DESCRIPTOR_SETS 16    // sets a frame's pool hands out between two resets
+#define FRAME_DESCRIPTOR_BUFFERS 16 // uniform and storage buffer descriptors each in those sets
+#define DESCRIPTOR_MODE_DYNAMIC 0   // one set per frame slot written at startup, the frame's uniforms are picked with a dynamic offset
+#define DESCRIPTOR_MODE_UPDATE 1    // a set taken from the frame's pool and written every frame, the churn dynamic offsets avoid
+#define BINDLESS_MAX_TEXTURES 16384
+#define BINDLESS_MAX_BUFFERS 16384
+#define BINDLESS_OTHER_RESOURCES 2 // the uniform buffers of set 0 and set 2 count against the same per stage limit
+// set 0 of the graphics pipeline, matches the uniform block of shader.vert
+struct frameUniforms {
+    float tint[4]; // multiplies every vertex color
+};
+// key and value of the layout cache, everything before layout is compared bytewise
+struct descriptorLayoutEntry {
+    VkDescriptorSetLayoutCreateFlags flags;
+    uint32_t bindingCount;
+    VkDescriptorSetLayoutBinding bindings[DESCRIPTOR_MAX_BINDINGS]; // without immutable samplers
+    VkDescriptorBindingFlags bindingFlags[DESCRIPTOR_MAX_BINDINGS];
+    VkDescriptorSetLayout layout;
+};
+// one VkDescriptorSetLayout per distinct list of bindings, shared by every pipeline layout asking for the same one
+struct descriptorCache {
+    VkDevice device;
+    struct descriptorLayoutEntry entries[DESCRIPTOR_MAX_LAYOUTS];
+    uint32_t count;
+    uint64_t hits;
+};
+// set 0 of the graphics pipeline, the frame's uniforms live in the frame's arena
+struct frameDescriptors {
+    uint32_t mode;                // DESCRIPTOR_MODE_*
+    VkDescriptorSetLayout layout; // owned by the cache
+    VkDescriptorPool pool;        // the sets of DESCRIPTOR_MODE_DYNAMIC, never reset
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT]; // bound for each frame slot, taken from the frame's pool every frame with DESCRIPTOR_MODE_UPDATE
+    uint32_t offsets[MAX_FRAMES_IN_FLIGHT];     // dynamic offset of each slot's frameUniforms
+    VkDeviceSize alignment;       // minUniformBufferOffsetAlignment
+    uint64_t setWrites;           // descriptors written after startup
+};
+// VK_EXT_descriptor_indexing, core in 1.2: one set of large sampled image and storage buffer arrays
+// each resource is written once when added and shaders pick it by index, nothing is rebound per draw
+struct bindlessTable {
+    VkDescriptorSetLayout layout; // owned by the cache
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint32_t maxTextures, maxBuffers;
+    uint32_t textureCount, bufferCount;
+};
+
+// everything a single frame needs while it is being recorded or executed on the gpu
+struct frameData {
+    struct commandAllocator commands; // reset once submitValue is reached
+    VkCommandBuffer commandBuffer;    // primary taken from commands for the frame being recorded
+    struct commandAllocator computeCommands; // async compute work of the frame, on the compute family
+    VkSemaphore imgAvailable;
+    VkSemaphore renderFinished;
+    uint64_t submitValue; // graphics timeline value of the slot's last submission, covers its compute work too
+    uint64_t frameNumber; // last frame submitted from this slot
+    struct linearArena arena; // transient per-frame data, reset once submitValue is reached
+    VkDescriptorPool descriptorPool; // transient sets, reset as a whole once submitValue is reached
+};
+#define DEFAULT_HEADLESS_FRAMES 1000
+#define DEFAULT_WARMUP_FRAMES 30
+struct appOptions {
+    uint32_t framesInFlight;
+    uint32_t headless;  // render into offscreen images, no window or surface
+    uint32_t maxFrames; // 0 runs until the window is closed
+    uint32_t bench;     // collect per-frame timings and report them on exit
+    uint32_t benchSeconds; // 0 means no time limit
+    uint32_t warmupFrames; // frames run before timings are collected
+    const char* benchJson; // optional path the report is also written to as json
+    const char* pipelineCachePath; // NULL disables the on-disk pipeline cache
+    uint32_t vertexLayout; // VERTEX_LAYOUT_*
+    uint32_t indexBits;    // 16 or 32, 0 picks the smallest that fits
+    uint32_t gridSize;     // 0 draws the triangle, N draws an NxN grid of quads
+    uint32_t instanceCount; // copies of the mesh drawn with one instanced draw
+    uint32_t cullMode;      // CULL_MODE_*
+    uint32_t separateDraws;
+    uint32_t recordThreads; // 0 records on the main thread
+    uint32_t cacheCommands; // reuse recorded command buffers while nothing they depend on changes
+    VkPresentModeKHR presentMode; // requested, replaced by the mode the surface granted
+    uint32_t framePacing;   // delay input sampling and recording until just before the vblank
+    const char* device;     // index or uuid of the physical device to use, NULL picks the best scoring one
+    uint32_t streamMB;      // size of the synthetic scene streamed in while rendering, 0 streams nothing
+    uint32_t streamBudgetKB; // staging bytes copied per frame, 0 for no limit
+    uint32_t dynamicRendering; // requested, cleared when the device has no VK_KHR_dynamic_rendering
+    uint32_t rebuildEvery;   // rebuild the swapchain every N frames to measure the cost, 0 only on resize
+    uint32_t computeBenchMB; // size of the reduction benchmark run on the compute queue before exit, 0 skips it
+    uint32_t descriptorMode; // DESCRIPTOR_MODE_*
+    uint32_t bindless;       // requested, cleared when the device has no VK_EXT_descriptor_indexing
+    uint32_t drawData;       // DRAW_DATA_*, push falls back to uniform when the payload does not fit in maxPushConstantsSize
+    uint32_t pipelineThreads;  // 0 compiles pipelines on the thread that asks for them
+    uint32_t pipelineVariants; // extra pipelines asked for while rendering, never drawn with
+    uint32_t colorMode;        // COLOR_MODE_*, specialized into the scene's pipeline
+    uint32_t tint;             // specialized too, 0 leaves the frame's tint out
+};
+
+#define DEFAULT_PIPELINE_CACHE_PATH "pipeline_cache.bin"
+
+#define PHASE_WAIT 0
+#define PHASE_ACQUIRE 1
+#define PHASE_PACE 2 // sleep of the frame pacer, 0 without --low-latency
+#define PHASE_RECORD 3
+#define PHASE_SUBMIT 4
+#define PHASE_PRESENT 5
+#define PHASE_FRAME 6
+#define PHASE_GPU 7 // gpu time of the frame scope, lags the cpu phases by the frames in flight
+#define PHASE_COUNT 8
+const char* phaseNames[PHASE_COUNT] = {"wait", "acquire", "pace", "record", "submit", "present", "frame", "gpu"};
+struct benchTimings {
+    double* samples[PHASE_COUNT]; // milliseconds spent in each phase, one entry per frame
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t gpuBound; // frames whose gpu time exceeded the cpu time spent producing them
+    double startupMs;  // process start until the first frame
+    double pipelineMs; // request of the scene's pipeline until it could be drawn with
+    uint32_t pipelineCacheLoaded;
+    double targetsMs;  // render pass and framebuffers, 0 with dynamic rendering
+    const struct resizeStats* resize; // swapchain rebuilds of the run
+    const struct pipelineRegistry* pipelines;
+    uint64_t placeholderFrames; // frames drawn without the scene while its pipeline compiled
+    double* latency; // input to display per frame, from presentLatency
+    uint64_t latencyCount;
+};
+// cost of rebuilding the swapchain and the delay between noticing a stale swapchain and presenting on the new one
+struct resizeStats {
+    uint32_t count;
+    double recreateMs;
+    double recreateMaxMs;
+    uint32_t latencyCount;
+    double latencyMs;
+    double latencyMaxMs;
+};
+
+#define MAX_TIMESTAMP_SCOPES 8
+// timestamp queries split into one range per frame in flight
+// results of a range are read once its frame slot's timeline value is reached so reading never stalls
+struct gpuTimer {
+    VkQueryPool queryPool; // VK_NULL_HANDLE when the graphics queue has no timestamp support
+    double msPerTick;
+    uint64_t validMask;
+    const char* scopeNames[MAX_FRAMES_IN_FLIGHT][MAX_TIMESTAMP_SCOPES];
+    uint32_t scopeCount[MAX_FRAMES_IN_FLIGHT]; // scopes written by the last submission of each slot
+    const char* resultNames[MAX_TIMESTAMP_SCOPES];
+    double resultMs[MAX_TIMESTAMP_SCOPES]; // scopes of the most recently completed frame
+    uint32_t resultCount;
 };
 
 #ifdef DEBUG
@@ -45,127 +733,725 @@ int CheckValidationLayers();
 #endif
 
 GLFWwindow* initWindow();
-int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger);
-int pickPhysicalDevice(VkPhysicalDevice* device, VkInstance instance, VkSurfaceKHR surface);
+void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger, uint32_t headless);
+int pickPhysicalDevice(VkPhysicalDevice* device, VkInstance instance, VkSurfaceKHR surface, const char* forced, VkPhysicalDeviceProperties* props);
 int isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
+static inline uint64_t scoreDevice(VkPhysicalDevice device, VkSurfaceKHR surface);
 int findQueueFamilies(VkPhysicalDevice physicalDevice, struct QueueFamilyIndices* indices, VkSurfaceKHR* surface);
-int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance instance, VkDevice* device, struct qHandles* queue, VkSurfaceKHR* surface);
-static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkImage** image, struct sChainImgInfo* imgInfo, VkSwapchainKHR* swapChain);
+int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance instance, VkDevice* device, struct qHandles* queue, VkSurfaceKHR* surface, VkPhysicalDeviceFeatures* enabled, uint32_t* presentWait, uint32_t* dynamicRendering, uint32_t* descriptorIndexing);
+static inline int deviceExtensionSupported(VkPhysicalDevice device, const char* name);
+static inline VkPresentModeKHR choosePresentMode(const VkPresentModeKHR* modes, uint32_t count, VkPresentModeKHR requested);
+static inline const char* presentModeName(VkPresentModeKHR mode);
+static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkImage** image, struct sChainImgInfo* imgInfo, VkExtent2D framebufferExtent, VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapChain, VkSwapchainKHR* swapChain);
+static inline int recreateSwapChain(GLFWwindow* window, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, struct syncLayer* sync, VkRenderPass renderPass,
+    struct presentLatency* latency, VkSwapchainKHR* swapChain, VkImage** images, VkImageView** imageViews, VkFramebuffer** frameBuffers, uint64_t** imagesInFlight, struct sChainImgInfo* imgInfo);
+static inline int createAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkPhysicalDeviceProperties* props, struct gpuAllocator* allocator);
+static inline int allocatorAlloc(struct gpuAllocator* allocator, VkMemoryRequirements* memReq, VkMemoryPropertyFlags properties, uint32_t linear, struct gpuAllocation* allocation);
+static inline void allocatorFree(struct gpuAllocator* allocator, struct gpuAllocation* allocation);
+static inline void allocatorGetStats(struct gpuAllocator* allocator, struct allocatorStats* stats);
+static inline void destroyAllocator(struct gpuAllocator* allocator);
+static inline int createBuffer(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, struct gpuAllocation* allocation);
+static inline int createSharedBuffer(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const uint32_t* families, uint32_t familyCount, VkBuffer* buffer, struct gpuAllocation* allocation);
+static inline void destroyBuffer(struct gpuAllocator* allocator, VkBuffer buffer, struct gpuAllocation* allocation);
+static inline int createLinearArena(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, struct linearArena* arena);
+static inline int arenaAlloc(struct linearArena* arena, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset, void** data);
+static inline void arenaReset(struct linearArena* arena);
+static inline int createOffscreenImages(struct gpuAllocator* allocator, uint32_t imageCount, VkImage** images, struct gpuAllocation** memory, struct sChainImgInfo* imgInfo);
 static inline int createImageViews(VkDevice device, VkImageView** imageViews, VkImage** images, struct sChainImgInfo* imgInfo);
-static inline int createGraphicsPipeline(VkDevice device, struct sChainImgInfo* imgInfo, VkRenderPass* renderPass, VkPipelineLayout* layout, VkPipeline* pipeline );
+static inline int createSampledImage(struct gpuAllocator* allocator, VkExtent3D extent, VkFormat format, VkImage* image, VkImageView* view, struct gpuAllocation* memory);
+static inline int createPipelineCache(VkDevice device, VkPhysicalDeviceProperties* props, const char* path, VkPipelineCache* cache, uint32_t* loaded);
+static inline int savePipelineCache(VkDevice device, VkPipelineCache cache, const char* path);
+static inline int createPipelineLayout(VkDevice device, uint32_t drawData, const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, VkPipelineLayout* layout);
+static inline void pipelineDescDefault(uint32_t vertexLayout, uint32_t drawData, VkPipelineLayout layout, VkRenderPass renderPass, VkFormat colorFormat, struct pipelineDesc* desc);
+static inline int pipelineShaderModule(struct pipelineRegistry* registry, const char* fileName, VkShaderModule* module);
+static inline int pipelineBuildInit(struct pipelineRegistry* registry, const struct pipelineDesc* desc, struct pipelineBuild* build);
+static inline uint64_t pipelineDescHash(const struct pipelineDesc* desc);
+static inline void pipelineCompileBatch(struct pipelineRegistry* registry, uint32_t first, uint32_t count);
+static inline int createPipelineRegistry(VkDevice device, VkPipelineCache cache, uint32_t threadCount, struct pipelineRegistry* registry);
+static inline int pipelineRequest(struct pipelineRegistry* registry, const struct pipelineDesc* desc, uint32_t* handle);
+static inline int pipelineGet(struct pipelineRegistry* registry, uint32_t handle, VkPipeline* pipeline);
+static inline void destroyPipelineRegistry(struct pipelineRegistry* registry);
 static inline int createRenderPass(VkDevice device, struct sChainImgInfo* imgInfo, VkRenderPass* renderPass);
 static inline int createFrameBuffers(VkDevice device , struct sChainImgInfo* imgInfo, VkImageView** imageViews, VkRenderPass* renderPass, VkFramebuffer* frameBuffers);
-static inline int createCommandPool(VkDevice device,VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface , VkCommandPool* commandPool);
+static inline int createCommandPool(VkDevice device,VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface , VkCommandPoolCreateFlags flags, VkCommandPool* commandPool);
+static inline int createFamilyCommandPool(VkDevice device, uint32_t family, VkCommandPoolCreateFlags flags, VkCommandPool* commandPool);
 static inline int createCommandBuffer( VkDevice device , VkCommandPool pool , VkCommandBuffer* commandBuffer);
-static inline int recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkFramebuffer* frameBuffers, VkRenderPass renderPass, struct sChainImgInfo* imgInfo, VkPipeline graphicsPipeline);
-static inline int createSyncObects(VkDevice device , VkSemaphore* imgAvailable, VkSemaphore* renderFinished, VkFence* inFlight );
+static inline int beginOneTimeCommands(VkDevice device, VkCommandPool pool, VkCommandBuffer* commandBuffer);
+static inline int endOneTimeCommands(VkDevice device, VkCommandPool pool, VkQueue queue, VkCommandBuffer commandBuffer);
+static inline int buildMesh(uint32_t gridSize, struct meshData* data);
+static inline int optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+static inline int optimizeVertexFetch(struct meshData* data);
+static inline double vertexCacheMissRatio(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+static inline void freeMeshData(struct meshData* data);
+static inline int createUploadContext(VkDevice device, struct qHandles* queues, struct uploadContext* upload);
+static inline int submitUpload(VkDevice device, struct uploadContext* upload, VkCommandBuffer commandBuffer, VkBufferMemoryBarrier* handoffs, uint32_t handoffCount, VkPipelineStageFlags dstStage);
+static inline void destroyUploadContext(VkDevice device, struct uploadContext* upload);
+static inline uint32_t deviceApiVersion(VkPhysicalDevice device);
+static inline int timelineSemaphoreSupported(VkPhysicalDevice device);
+static inline int createSyncLayer(VkDevice device, struct qHandles* queues, struct syncLayer* sync);
+static inline void syncWaitBinary(struct syncWaits* waits, VkSemaphore semaphore, VkPipelineStageFlags stage);
+static inline void syncWaitTimeline(struct syncWaits* waits, struct syncLayer* sync, uint32_t queue, uint64_t value, VkPipelineStageFlags stage);
+static inline int syncSubmit(struct syncLayer* sync, uint32_t queue, struct syncWaits* waits, VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, VkSemaphore binarySignal, uint64_t* value);
+static inline uint64_t syncCompleted(struct syncLayer* sync, uint32_t queue);
+static inline int syncReached(struct syncLayer* sync, uint32_t queue, uint64_t value);
+static inline int syncWait(struct syncLayer* sync, uint32_t queue, uint64_t value);
+static inline void destroySyncLayer(struct syncLayer* sync);
+static inline int createUploadStream(struct gpuAllocator* allocator, struct qHandles* queues, struct syncLayer* sync, VkDeviceSize ringSize, VkDeviceSize bytesPerFrame, struct uploadStream* stream);
+static inline uint64_t streamUploadBuffer(struct uploadStream* stream, VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+static inline uint64_t streamUploadImage(struct uploadStream* stream, VkImage image, VkExtent3D extent, uint32_t texelSize, VkImageLayout finalLayout, const void* data, VkDeviceSize size);
+static inline int streamSubmit(struct uploadStream* stream, uint64_t* value);
+static inline int streamRecordAcquires(struct uploadStream* stream, VkCommandBuffer commandBuffer, uint64_t* value);
+static inline int streamPoll(struct uploadStream* stream, uint64_t ticket);
+static inline int streamWait(struct uploadStream* stream, uint64_t ticket);
+static inline void destroyUploadStream(struct gpuAllocator* allocator, struct uploadStream* stream);
+static inline int uploadMesh(struct gpuAllocator* allocator, struct uploadContext* upload, struct meshData* data, uint32_t vertexLayout, uint32_t indexBits, struct mesh* mesh);
+static inline void destroyMesh(struct gpuAllocator* allocator, struct mesh* mesh);
+static inline int createInstanceRing(struct gpuAllocator* allocator, struct qHandles* queues, uint32_t instanceCount, uint32_t frameCount, uint32_t drawData, struct instanceRing* ring);
+static inline void updateInstances(struct instanceRing* ring, uint32_t frameSlot, uint64_t frameNumber, float panX, float cullRadius);
+static inline float meshBoundingRadius(struct meshData* data);
+static inline int createCuller(struct gpuAllocator* allocator, struct qHandles* queues, VkPhysicalDeviceProperties* props, struct descriptorCache* descriptors, VkPipelineCache cache, struct instanceRing* instances, uint32_t frameCount, uint32_t indexCount, float meshRadius, struct gpuCuller* culler);
+static inline void recordCulling(VkCommandBuffer commandBuffer, struct gpuCuller* culler, uint32_t frameSlot);
+static inline void recordCullingAcquire(VkCommandBuffer commandBuffer, struct gpuCuller* culler, uint32_t frameSlot);
+static inline int submitCulling(VkDevice device, struct syncLayer* sync, struct frameData* frame, struct gpuCuller* culler, uint32_t frameSlot, uint64_t* value);
+static inline uint32_t cullerVisibleCount(struct gpuCuller* culler, uint32_t frameSlot);
+static inline void destroyCuller(struct gpuAllocator* allocator, struct gpuCuller* culler);
+static inline void destroyInstanceRing(struct gpuAllocator* allocator, struct instanceRing* ring);
+static inline int createComputeKernel(struct descriptorCache* descriptors, VkPipelineCache cache, const char* shaderFile, const VkDescriptorType* types, uint32_t bindingCount, uint32_t pushSize, uint32_t maxSets, struct computeKernel* kernel);
+static inline int computeKernelSet(struct computeKernel* kernel, const struct computeBinding* bindings, VkDescriptorSet* set);
+static inline void recordDispatch(VkCommandBuffer commandBuffer, struct computeKernel* kernel, VkDescriptorSet set, const void* push, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+static inline void destroyComputeKernel(struct computeKernel* kernel);
+static inline int createComputeContext(struct gpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* props, struct qHandles* queues, struct syncLayer* sync, struct computeContext* context);
+static inline int computeBegin(struct computeContext* context, VkCommandBuffer* commandBuffer);
+static inline int computeEnd(struct computeContext* context, VkCommandBuffer commandBuffer, double* ms);
+static inline int computeRun(struct computeContext* context, struct computeKernel* kernel, VkDescriptorSet set, const void* push, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, double* ms);
+static inline int computeUpload(struct computeContext* context, VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size);
+static inline int computeReadback(struct computeContext* context, VkBuffer src, VkDeviceSize offset, void* data, VkDeviceSize size);
+static inline int computeBenchmark(struct computeContext* context, VkPhysicalDeviceProperties* props, struct descriptorCache* descriptors, VkPipelineCache cache, uint32_t megabytes);
+static inline void destroyComputeContext(struct computeContext* context);
+static inline int createRecordPool(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface, uint32_t threadCount, uint32_t frameCount, struct recordPool* pool);
+static inline int recordPoolRun(struct recordPool* pool, struct recordJob* job);
+static inline void destroyRecordPool(struct recordPool* pool);
+static inline void recordDraws(VkCommandBuffer commandBuffer, VkPipeline graphicsPipeline, VkExtent2D extent, struct drawList* draws, uint32_t frameSlot, uint32_t first, uint32_t count);
+static inline int dynamicRenderingSupported(VkPhysicalDevice device);
+static inline int createDynamicRendering(VkDevice device, struct dynamicRendering* rendering);
+static inline void recordBeginRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, struct dynamicRendering* rendering, VkImage image, VkImageView view, struct sChainImgInfo* imgInfo, uint32_t secondaries);
+static inline void recordEndRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass, struct dynamicRendering* rendering, VkImage image, struct sChainImgInfo* imgInfo);
+static inline int recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkFramebuffer* frameBuffers, VkRenderPass renderPass, struct dynamicRendering* rendering, VkImage* images, VkImageView* imageViews,
+    struct sChainImgInfo* imgInfo, VkPipeline graphicsPipeline, struct drawList* draws, struct recordPool* recorder, struct gpuTimer* timer, uint32_t frameSlot);
+static inline int createGpuTimer(VkDevice device, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* props, VkSurfaceKHR* surface, uint32_t frameCount, struct gpuTimer* timer);
+static inline void gpuTimerReset(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot);
+static inline uint32_t gpuTimerBegin(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot, const char* name);
+static inline void gpuTimerEnd(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope);
+static inline int gpuTimerCollect(VkDevice device, struct gpuTimer* timer, uint32_t frameSlot);
+static inline double gpuTimerResult(struct gpuTimer* timer, const char* name);
+static inline int createSyncObects(VkDevice device , VkSemaphore* imgAvailable, VkSemaphore* renderFinished);
+static inline int createCommandAllocator(VkDevice device, uint32_t family, struct commandAllocator* commands);
+static inline void commandAllocatorReset(VkDevice device, struct commandAllocator* commands);
+static inline int commandAllocatorGet(VkDevice device, struct commandAllocator* commands, VkCommandBuffer* commandBuffer);
+static inline void destroyCommandAllocator(VkDevice device, struct commandAllocator* commands);
+static inline int descriptorLayoutGet(struct descriptorCache* cache, const VkDescriptorSetLayoutBinding* bindings, const VkDescriptorBindingFlags* bindingFlags, uint32_t bindingCount, VkDescriptorSetLayoutCreateFlags flags, VkDescriptorSetLayout* layout);
+static inline void destroyDescriptorCache(struct descriptorCache* cache);
+static inline int frameDescriptorLayout(struct descriptorCache* cache, uint32_t mode, VkDescriptorSetLayout* layout);
+static inline int createFrameDescriptors(struct descriptorCache* cache, VkPhysicalDeviceProperties* props, uint32_t mode, VkDeviceSize range, struct frameData* frames, uint32_t frameCount, struct frameDescriptors* descriptors);
+static inline int frameDescriptorAlloc(VkDevice device, struct frameData* frame, VkDescriptorSetLayout layout, VkDescriptorSet* set);
+static inline int frameDescriptorsUpdate(VkDevice device, struct frameDescriptors* descriptors, struct frameData* frame, uint32_t frameSlot, const struct frameUniforms* uniforms);
+static inline void destroyFrameDescriptors(VkDevice device, struct frameDescriptors* descriptors);
+static inline VkDeviceSize drawUniformStride(VkDeviceSize alignment);
+static inline int writeDrawUniforms(struct instanceRing* ring, struct frameDescriptors* drawUniforms, struct frameData* frame, uint32_t frameSlot);
+static inline int descriptorIndexingSupported(VkPhysicalDevice device);
+static inline int createBindlessTable(VkPhysicalDevice physicalDevice, struct descriptorCache* cache, struct bindlessTable* table);
+static inline uint32_t bindlessAddBuffer(VkDevice device, struct bindlessTable* table, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+static inline uint32_t bindlessAddTexture(VkDevice device, struct bindlessTable* table, VkImageView view);
+static inline void destroyBindlessTable(VkDevice device, struct bindlessTable* table);
+static inline int createCommandCache(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface, uint32_t imageCount, uint32_t frameCount, struct commandCache* cache);
+static inline void commandCacheMakeKey(struct commandCache* cache, VkImageView attachment, VkRenderPass renderPass, VkPipeline pipeline, VkExtent2D extent, uint32_t drawCount, struct commandCacheKey* key);
+static inline int commandCacheLookup(VkDevice device, struct commandCache* cache, uint32_t imageIndex, uint32_t frameSlot, struct commandCacheKey* key, struct commandCacheEntry** entry, uint32_t* hit);
+static inline void commandCacheInvalidate(struct commandCache* cache);
+static inline int commandCacheResize(VkDevice device, struct commandCache* cache, uint32_t imageCount);
+static inline int createPresentLatency(VkDevice device, VkSwapchainKHR swapChain, uint32_t enabled, struct presentLatency* latency);
+static inline uint64_t presentLatencyBegin(struct presentLatency* latency, double sampleMs);
+static inline void presentLatencyMeasureFrom(struct presentLatency* latency);
+static inline double presentLatencyLastPresent(struct presentLatency* latency);
+static inline void presentLatencySetSwapChain(struct presentLatency* latency, VkSwapchainKHR swapChain);
+static inline void presentLatencyLock(struct presentLatency* latency);
+static inline void presentLatencyUnlock(struct presentLatency* latency);
+static inline void presentLatencyQueued(struct presentLatency* latency, uint64_t id);
+static inline void destroyPresentLatency(struct presentLatency* latency);
+static inline void createFramePacer(GLFWwindow* window, struct framePacer* pacer);
+static inline void framePacerWait(struct framePacer* pacer, struct presentLatency* latency);
+static inline void framePacerUpdate(struct framePacer* pacer, double workMs);
+static inline void sleepUntilMs(double deadline);
+static inline void destroyCommandCache(VkDevice device, struct commandCache* cache);
+static inline int createFrameRing(VkDevice device, struct qHandles* queues, struct gpuAllocator* allocator, VkDeviceSize arenaSize, struct frameData* frames, uint32_t frameCount);
+static inline void destroyFrameRing(VkDevice device, struct gpuAllocator* allocator, struct frameData* frames, uint32_t frameCount);
+int parseOptions(int argc, char** argv, struct appOptions* options);
+static inline double timeMs();
+static inline int benchRecord(struct benchTimings* bench, const double* phases);
+static inline void benchReport(struct benchTimings* bench, double elapsed, struct appOptions* options);
+static inline void benchFree(struct benchTimings* bench);
+
+int main(int argc, char** argv){
+    double processStart = timeMs();
+    struct appOptions options;
+    if(parseOptions(argc, argv, &options)) return -1;
 
-int main(){
-    GLFWwindow* window = initWindow();
-    if(!window) return -1;
+    GLFWwindow* window = NULL;
+    if(!options.headless){
+        window = initWindow();
+        if(!window) return -1;
+    }
 
     VkInstance vulkan;
 #ifdef DEBUG
     VkDebugUtilsMessengerEXT debugMessenger;
-    if(initVulkan(&vulkan, &debugMessenger)) return -1;
+    if(initVulkan(&vulkan, &debugMessenger, options.headless)) return -1;
 #else
-    if(initVulkan(&vulkan, NULL)) return -1;
+    if(initVulkan(&vulkan, NULL, options.headless)) return -1;
 #endif
 
-    VkSurfaceKHR surface;
-    if(glfwCreateWindowSurface(vulkan, window, NULL, &surface) != VK_SUCCESS) {
+    VkSurfaceKHR surface = VK_NULL_HANDLE; // stays null when headless
+    if(!options.headless && glfwCreateWindowSurface(vulkan, window, NULL, &surface) != VK_SUCCESS) {
         fprintf(stdout, "ERROR: window surface creation failed");
         return -1;
     }
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    if(pickPhysicalDevice(&physicalDevice,vulkan,surface)) return -1;
+    VkPhysicalDeviceProperties deviceProps;
+    if(pickPhysicalDevice(&physicalDevice,vulkan,surface, options.device, &deviceProps)) return -1;
 
     VkDevice device;
     struct qHandles Queue;
-    if(createLogicalDevice(physicalDevice,vulkan,&device, &Queue, &surface)) return -1;
+    VkPhysicalDeviceFeatures features;
+    uint32_t presentWait, dynamicSupported, indexingSupported;
+    if(createLogicalDevice(physicalDevice,vulkan,&device, &Queue, &surface, &features, &presentWait, &dynamicSupported, &indexingSupported)) return -1;
+    if(options.dynamicRendering && !dynamicSupported){
+        fprintf(stdout, "WARNING: VK_KHR_dynamic_rendering NOT SUPPORTED, USING A RENDER PASS AND FRAMEBUFFERS\n");
+        options.dynamicRendering = 0;
+    }
+    struct dynamicRendering rendering = {NULL, NULL};
+    if(options.dynamicRendering && createDynamicRendering(device, &rendering)) return -1;
+    if(options.bindless && !indexingSupported){
+        fprintf(stdout, "WARNING: VK_EXT_descriptor_indexing NOT SUPPORTED, BINDLESS DISABLED\n");
+        options.bindless = 0;
+    }
+    // per-object indirect draws pick their instance through firstInstance and need more than one draw per call
+    if(options.cullMode == CULL_MODE_GPU && !(features.multiDrawIndirect && features.drawIndirectFirstInstance)){
+        fprintf(stdout, "WARNING: multiDrawIndirect OR drawIndirectFirstInstance NOT SUPPORTED, CULLING ON THE CPU INSTEAD\n");
+        options.cullMode = CULL_MODE_CPU;
+    }
+
+    struct gpuAllocator allocator;
+    if(createAllocator(physicalDevice, device, &deviceProps, &allocator)) return -1;
+    struct syncLayer sync;
+    if(createSyncLayer(device, &Queue, &sync)) return -1;
 
-    VkSwapchainKHR swapChain;
-    VkImage* swapChainImages;  //Actual ImageLocations (currently in RAM and not VRAM)
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    VkImage* swapChainImages = NULL;  //Actual ImageLocations (currently in RAM and not VRAM)
+    struct gpuAllocation* offscreenMemory = NULL; // backs swapChainImages when headless
     struct sChainImgInfo imgInfo;
-    if(createSwapChain( physicalDevice, surface, device, &swapChainImages, &imgInfo, &swapChain)) return -1;
+    if(options.headless){
+        if(createOffscreenImages(&allocator, options.framesInFlight, &swapChainImages, &offscreenMemory, &imgInfo)) return -1;
+    } else {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        if(createSwapChain( physicalDevice, surface, device, &swapChainImages, &imgInfo, (VkExtent2D){width, height}, options.presentMode, VK_NULL_HANDLE, &swapChain)) return -1;
+        options.presentMode = imgInfo.presentMode;
+    }
 
-    VkImageView* sChainImageViews;
+    VkImageView* sChainImageViews = NULL;
     if(createImageViews(device,&sChainImageViews, &swapChainImages, &imgInfo)) return -1;
 
-    VkRenderPass renderPass;
-    if(createRenderPass(device,&imgInfo, &renderPass)) return -1;
+    struct benchTimings bench = {0};
+    // stays null with dynamic rendering, which is how everything else tells the two paths apart
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    double targetsStart = timeMs();
+    if(!options.dynamicRendering && createRenderPass(device,&imgInfo, &renderPass)) return -1;
+    bench.targetsMs = timeMs() - targetsStart;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    if(options.pipelineCachePath && createPipelineCache(device, &deviceProps, options.pipelineCachePath, &pipelineCache, &bench.pipelineCacheLoaded)) return -1;
 
+    struct descriptorCache descriptorCache = {.device = device, .count = 0, .hits = 0};
+    VkDescriptorSetLayout setLayouts[3]; // the frame's uniforms, the bindless table, then the per-draw uniforms
+    uint32_t setLayoutCount = 1;
+    if(frameDescriptorLayout(&descriptorCache, options.descriptorMode, setLayouts)) return -1;
+    struct bindlessTable bindless;
+    if(options.bindless){
+        if(createBindlessTable(physicalDevice, &descriptorCache, &bindless)) return -1;
+        setLayouts[setLayoutCount++] = bindless.layout;
+    }
+    if(options.drawData == DRAW_DATA_PUSH && sizeof(struct drawConstants) > deviceProps.limits.maxPushConstantsSize){
+        fprintf(stdout, "WARNING: %u BYTES OF PER-DRAW DATA DO NOT FIT IN %u BYTES OF PUSH CONSTANTS, FALLING BACK TO THE UNIFORM RING\n",
+            (uint32_t)sizeof(struct drawConstants), deviceProps.limits.maxPushConstantsSize);
+        options.drawData = DRAW_DATA_UNIFORM;
+    }
+    VkDescriptorSetLayout drawUniformLayout;
+    if(options.drawData == DRAW_DATA_UNIFORM){
+        // set 1 stays empty without bindless, set 2 is the same dynamic uniform buffer layout set 0 uses by default
+        if(!options.bindless && descriptorLayoutGet(&descriptorCache, NULL, NULL, 0, 0, setLayouts + 1)) return -1;
+        if(frameDescriptorLayout(&descriptorCache, DESCRIPTOR_MODE_DYNAMIC, &drawUniformLayout)) return -1;
+        setLayouts[2] = drawUniformLayout;
+        setLayoutCount = 3;
+    }
     VkPipelineLayout layout;
-    VkPipeline pipeline;
-    if(createGraphicsPipeline(device,&imgInfo, &renderPass, &layout, &pipeline)) return -1;
+    if(createPipelineLayout(device, options.drawData, setLayouts, setLayoutCount, &layout)) return -1;
+    struct pipelineRegistry pipelines;
+    if(createPipelineRegistry(device, pipelineCache, options.pipelineThreads, &pipelines)) return -1;
+    // compiles while the rest of startup runs, frames before it is done are drawn without the scene
+    struct pipelineDesc sceneDesc;
+    pipelineDescDefault(options.vertexLayout, options.drawData, layout, renderPass, imgInfo.swapChainImageFormat, &sceneDesc);
+    sceneDesc.specialization[SPEC_COLOR_MODE] = options.colorMode;
+    sceneDesc.specialization[SPEC_TINT] = options.tint ? VK_TRUE : VK_FALSE;
+    uint32_t scenePipeline;
+    if(pipelineRequest(&pipelines, &sceneDesc, &scenePipeline)) return -1;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    uint64_t placeholderFrames = 0;
+
+    VkFramebuffer* frameBuffers = NULL; // resized together with the swapchain, NULL with dynamic rendering
+    if(!options.dynamicRendering){
+        targetsStart = timeMs();
+        if((frameBuffers = malloc(sizeof(VkFramebuffer) * imgInfo.swapChainImageCount)) == NULL){
+            fprintf(stdout, "ERROR: FRAMEBUFFER MALLOC FAILED\n");
+            return -1;
+        }
+        if(createFrameBuffers(device, &imgInfo, &sChainImageViews, &renderPass, frameBuffers )) return -1;
+        bench.targetsMs += timeMs() - targetsStart;
+    }
+
+    VkCommandPool commandPool; // setup work only, every frame in flight records from its own pool
+    if(createCommandPool(device, physicalDevice, &surface, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &commandPool )) return -1;
+
+    struct uploadContext upload;
+    if(createUploadContext(device, &Queue, &upload)) return -1;
+
+    struct meshData meshData;
+    if(buildMesh(options.gridSize, &meshData)) return -1;
+    double missBefore = vertexCacheMissRatio(meshData.indices, meshData.indexCount, meshData.vertexCount, FIFO_CACHE_SIZE);
+    if(optimizeVertexCache(meshData.indices, meshData.indexCount, meshData.vertexCount) || optimizeVertexFetch(&meshData)) return -1;
+    fprintf(stdout, "Mesh: %u vertices, %u triangles, vertex cache misses per triangle %.3f -> %.3f\n", meshData.vertexCount, meshData.indexCount / 3,
+        missBefore, vertexCacheMissRatio(meshData.indices, meshData.indexCount, meshData.vertexCount, FIFO_CACHE_SIZE));
+    struct mesh mesh;
+    if(uploadMesh(&allocator, &upload, &meshData, options.vertexLayout, options.indexBits, &mesh)) return -1;
+    float meshRadius = meshBoundingRadius(&meshData);
+    freeMeshData(&meshData);
+    struct instanceRing instances;
+    if(createInstanceRing(&allocator, &Queue, options.instanceCount, options.framesInFlight, options.drawData, &instances)) return -1;
+    struct gpuCuller culler;
+    if(options.cullMode == CULL_MODE_GPU &&
+        createCuller(&allocator, &Queue, &deviceProps, &descriptorCache, pipelineCache, &instances, options.framesInFlight, mesh.indexCount, meshRadius, &culler)) return -1;
+
+    struct frameDescriptors frameDescriptors, drawUniforms;
+    struct drawList draws = {&mesh, &instances, options.cullMode == CULL_MODE_GPU ? &culler : NULL, options.separateDraws,
+        layout, &frameDescriptors, options.bindless ? &bindless : NULL, options.drawData, &drawUniforms};
+    struct recordPool recorder;
+    if(options.recordThreads && createRecordPool(device, physicalDevice, &surface, options.recordThreads, options.framesInFlight, &recorder)) return -1;
+
+    struct frameData frames[MAX_FRAMES_IN_FLIGHT]; // ring of per-frame resources
+    VkDeviceSize arenaSize = FRAME_ARENA_SIZE;
+    if(options.drawData == DRAW_DATA_UNIFORM) arenaSize += drawUniformStride(deviceProps.limits.minUniformBufferOffsetAlignment) * options.instanceCount;
+    if(createFrameRing(device, &Queue, &allocator, arenaSize, frames, options.framesInFlight)) return -1;
+    if(createFrameDescriptors(&descriptorCache, &deviceProps, options.descriptorMode, sizeof(struct frameUniforms), frames, options.framesInFlight, &frameDescriptors)) return -1;
+    if(options.drawData == DRAW_DATA_UNIFORM &&
+        createFrameDescriptors(&descriptorCache, &deviceProps, DESCRIPTOR_MODE_DYNAMIC, sizeof(struct drawConstants), frames, options.framesInFlight, &drawUniforms)) return -1;
+    // every slice of the instance ring gets an index, shaders can then reach any frame's instances from one set
+    for(uint32_t i = 0; options.bindless && i < options.framesInFlight; i++){
+        if(bindlessAddBuffer(device, &bindless, instances.buffer, instances.sliceSize * i, instances.sliceSize) == UINT32_MAX) return -1;
+    }
+    // culling overlaps the previous frame's rendering when compute has a family of its own
+    uint32_t asyncCompute = options.cullMode == CULL_MODE_GPU && Queue.computeFamily != Queue.graphicsFamily;
+
+    struct commandCache commandCache;
+    if(options.cacheCommands && createCommandCache(device, physicalDevice, &surface, imgInfo.swapChainImageCount, options.framesInFlight, &commandCache)) return -1;
 
-    VkFramebuffer frameBuffers[imgInfo.swapChainImageCount];
-    if(createFrameBuffers(device, &imgInfo, &sChainImageViews, &renderPass, frameBuffers )) return -1;
+    struct presentLatency latency;
+    if(createPresentLatency(device, swapChain, presentWait, &latency)) return -1;
+    struct framePacer pacer;
+    if(options.framePacing){
+        if(options.headless){
+            fprintf(stdout, "WARNING: NOTHING IS PRESENTED WHEN HEADLESS, FRAME PACING DISABLED\n");
+            options.framePacing = 0;
+        } else {
+            if(latency.waitForPresent == NULL) fprintf(stdout, "WARNING: VK_KHR_present_wait NOT SUPPORTED, FRAME PACING FOLLOWS THE NOMINAL REFRESH RATE\n");
+            createFramePacer(window, &pacer);
+        }
+    }
 
-    VkCommandPool commandPool; // contains command buffers
-    if(createCommandPool(device, physicalDevice, &surface, &commandPool )) return -1;
+    // a synthetic scene streamed into one buffer and one texture while rendering, the pieces are queued up front and drained under the budget
+    struct uploadStream stream;
+    VkBuffer sceneBuffer = VK_NULL_HANDLE;
+    struct gpuAllocation sceneMemory;
+    char* sceneData = NULL;
+    VkImage sceneTexture = VK_NULL_HANDLE;
+    VkImageView sceneTextureView = VK_NULL_HANDLE;
+    struct gpuAllocation sceneTextureMemory;
+    uint32_t* textureData = NULL;
+    uint64_t sceneTicket = 0, sceneFrames = 0;
+    double sceneMs = 0.0; // from the first frame until the last piece landed
+    if(createUploadStream(&allocator, &Queue, &sync, STREAM_RING_SIZE, (VkDeviceSize)options.streamBudgetKB << 10, &stream)) return -1;
+    if(options.streamMB){
+        VkDeviceSize sceneSize = (VkDeviceSize)options.streamMB << 20;
+        uint32_t families[2] = {Queue.graphicsFamily, Queue.transferFamily};
+        if(createSharedBuffer(&allocator, sceneSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            families, 2, &sceneBuffer, &sceneMemory)) return -1;
+        if((sceneData = malloc(sceneSize)) == NULL){
+            fprintf(stdout, "ERROR: SCENE MALLOC FAILED\n");
+            return -1;
+        }
+        for(VkDeviceSize i = 0; i < sceneSize; i++) sceneData[i] = (char)(i * 31);
+        uint32_t pieces = 0;
+        for(VkDeviceSize offset = 0; offset < sceneSize; pieces++){
+            VkDeviceSize piece = pieces % 8 == 7 ? STREAM_LARGE_ASSET : STREAM_SMALL_ASSET;
+            if(piece > sceneSize - offset) piece = sceneSize - offset;
+            if((sceneTicket = streamUploadBuffer(&stream, sceneBuffer, offset, sceneData + offset, piece)) == 0) return -1;
+            offset += piece;
+        }
+        // exclusive to the graphics family, a separate transfer family releases it and the frame that takes the batch acquires it
+        VkExtent3D textureExtent = {STREAM_TEXTURE_SIZE, STREAM_TEXTURE_SIZE, 1};
+        VkDeviceSize textureSize = sizeof(uint32_t) * STREAM_TEXTURE_SIZE * STREAM_TEXTURE_SIZE;
+        if(createSampledImage(&allocator, textureExtent, VK_FORMAT_R8G8B8A8_UNORM, &sceneTexture, &sceneTextureView, &sceneTextureMemory)) return -1;
+        if((textureData = malloc(textureSize)) == NULL){
+            fprintf(stdout, "ERROR: SCENE TEXTURE MALLOC FAILED\n");
+            return -1;
+        }
+        for(uint32_t i = 0; i < STREAM_TEXTURE_SIZE * STREAM_TEXTURE_SIZE; i++) textureData[i] = ((i / STREAM_TEXTURE_SIZE + i) & 16) ? 0xffffffffu : 0xff000000u;
+        if((sceneTicket = streamUploadImage(&stream, sceneTexture, textureExtent, sizeof(uint32_t), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, textureData, textureSize)) == 0) return -1;
+        fprintf(stdout, "Streaming %u MB in %u pieces and a %ux%u texture at %u KB per frame\n", options.streamMB, pieces, STREAM_TEXTURE_SIZE, STREAM_TEXTURE_SIZE, options.streamBudgetKB);
+    }
 
-    VkCommandBuffer commandBuffer; // contains the actual commands
-    if(createCommandBuffer(device, commandPool, &commandBuffer ) ) return -1;
+    struct gpuTimer gpuTimer;
+    if(createGpuTimer(device, physicalDevice, &deviceProps, &surface, options.framesInFlight, &gpuTimer)) return -1;
 
-    VkSemaphore imgAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
-    if(createSyncObects(device, &imgAvailableSemaphore, &renderFinishedSemaphore, &inFlightFence)) return -1;
+    uint64_t* imagesInFlight = NULL; // graphics timeline value of the last frame rendered to each swapchain image
+    if((imagesInFlight = malloc(sizeof(uint64_t) * imgInfo.swapChainImageCount)) == NULL){
+        fprintf(stdout, "ERROR: IMAGE TIMELINE MALLOC FAILED\n");
+        return -1;
+    }
+    for(uint32_t i = 0; i < imgInfo.swapChainImageCount; i++) imagesInFlight[i] = 0;
+    struct resizeStats resize = {0};
+    double staleSince = 0.0;  // when the swapchain was found to no longer match the surface, 0 while it does
+    double resizeStart = 0.0; // staleSince of the last rebuild until something is presented on the new swapchain
 
-    while (!glfwWindowShouldClose(window))
+    uint64_t frameCount = 0;
+    double loopStart = timeMs();
+    bench.startupMs = loopStart - processStart;
+    fprintf(stdout, "Startup: %.2f ms, pipelines on %u threads (pipeline cache %s), %s %.3f ms\n", bench.startupMs, options.pipelineThreads,
+        !options.pipelineCachePath ? "disabled" : bench.pipelineCacheLoaded ? "loaded" : "cold",
+        options.dynamicRendering ? "dynamic rendering, no render targets" : "render pass and framebuffers", bench.targetsMs);
+    double benchStart = loopStart;
+    while (options.headless || !glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFence);
+        if(options.maxFrames && frameCount >= (uint64_t)options.maxFrames + options.warmupFrames) break;
+        if(options.benchSeconds && frameCount > options.warmupFrames && timeMs() - benchStart >= options.benchSeconds * 1000.0) break;
+        if(frameCount == options.warmupFrames){
+            benchStart = timeMs();
+            presentLatencyMeasureFrom(&latency);
+        }
+        if(!options.headless){
+            glfwPollEvents();
+            if(framebufferResized && !staleSince) staleSince = timeMs();
+            if(options.rebuildEvery && frameCount && frameCount % options.rebuildEvery == 0 && !staleSince) staleSince = timeMs();
+            if(staleSince){
+                // rebuilt at the top of a frame so no slot holds an image of the old swapchain in the middle of recording
+                framebufferResized = 0;
+                double recreateStart = timeMs();
+                if(recreateSwapChain(window, physicalDevice, surface, device, &sync, renderPass,
+                    &latency, &swapChain, &swapChainImages, &sChainImageViews, &frameBuffers, &imagesInFlight, &imgInfo)) return -1;
+                if(options.cacheCommands && commandCacheResize(device, &commandCache, imgInfo.swapChainImageCount)) return -1;
+                double recreateMs = timeMs() - recreateStart;
+                resize.count++;
+                resize.recreateMs += recreateMs;
+                if(recreateMs > resize.recreateMaxMs) resize.recreateMaxMs = recreateMs;
+                resizeStart = staleSince;
+                staleSince = 0.0;
+            }
+        }
+        double phaseStart[PHASE_COUNT];
+        phaseStart[PHASE_WAIT] = timeMs();
+        double sampleMs = phaseStart[PHASE_WAIT]; // when input was last read for this frame
+        uint32_t frameSlot = frameCount % options.framesInFlight;
+        struct frameData* frame = frames + frameSlot;
+        // only blocks if the gpu is still working on the frame that used this slot framesInFlight frames ago
+        if(syncWait(&sync, SYNC_GRAPHICS, frame->submitValue)) return -1;
+        if(gpuTimerCollect(device, &gpuTimer, frameSlot)) return -1;
+        arenaReset(&frame->arena);
+        commandAllocatorReset(device, &frame->commands);
+        commandAllocatorReset(device, &frame->computeCommands);
+        vkResetDescriptorPool(device, frame->descriptorPool, 0);
+        phaseStart[PHASE_ACQUIRE] = timeMs();
         uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imgAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-        vkResetCommandBuffer(commandBuffer, 0 );
-        if(recordCommandBuffer(commandBuffer, imageIndex, frameBuffers, renderPass, &imgInfo, pipeline)) return -1;
+        if(options.headless) imageIndex = frameCount % imgInfo.swapChainImageCount;
+        else {
+            presentLatencyLock(&latency);
+            VkResult acquired = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame->imgAvailable, VK_NULL_HANDLE, &imageIndex);
+            presentLatencyUnlock(&latency);
+            if(acquired == VK_ERROR_OUT_OF_DATE_KHR){
+                // nothing was submitted, the slot is retried on the new swapchain
+                if(!staleSince) staleSince = timeMs();
+                continue;
+            }
+            if(acquired != VK_SUCCESS && acquired != VK_SUBOPTIMAL_KHR){
+                fprintf(stdout, "ERROR: FAILED TO ACQUIRE SWAPCHAIN IMAGE\n");
+                return -1;
+            }
+            // a suboptimal image is still rendered and presented, the swapchain is rebuilt before the next frame
+            if(acquired == VK_SUBOPTIMAL_KHR && !staleSince) staleSince = timeMs();
+        }
+        // the swapchain may hand out an image an older slot is still rendering to
+        if(syncWait(&sync, SYNC_GRAPHICS, imagesInFlight[imageIndex])) return -1;
 
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &imgAvailableSemaphore,
-            .pWaitDstStageMask = &waitStage,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &renderFinishedSemaphore
-        };
-        if(vkQueueSubmit(Queue.graphics, 1, &submitInfo, inFlightFence ) != VK_SUCCESS ){
-            fprintf(stdout, "ERROR: FAILED TO SUBMIT QUEUE\n");
-            return -1;
+        phaseStart[PHASE_PACE] = timeMs();
+        if(options.framePacing){
+            // the image is already ours, only the input and the recording are held back
+            framePacerWait(&pacer, &latency);
+            glfwPollEvents();
+            sampleMs = timeMs();
         }
-        VkPresentInfoKHR presentInfo = {
-            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &renderFinishedSemaphore,
-            .swapchainCount = 1,
-            .pSwapchains = &swapChain,
-            .pImageIndices = &imageIndex,
-            .pResults = NULL
-        };
-        vkQueuePresentKHR(Queue.graphics,&presentInfo);
+        phaseStart[PHASE_RECORD] = timeMs();
+        // culling modes scroll the instance field sideways so part of it is always off screen
+        float panX = options.cullMode == CULL_MODE_OFF ? 0.0f : sinf(6.2831853f * (frameCount % CULL_PAN_PERIOD) / CULL_PAN_PERIOD);
+        updateInstances(&instances, frameSlot, frameCount, panX, options.cullMode == CULL_MODE_CPU ? meshRadius : 0.0f);
+        // a burst of new state partway through the run, like a level streaming in, must not stall the frame asking for it
+        if(options.pipelineVariants && frameCount == options.warmupFrames + PIPELINE_VARIANT_FRAME){
+            for(uint32_t i = 0; i < options.pipelineVariants; i++){
+                struct pipelineDesc variant;
+                memcpy(&variant, &sceneDesc, sizeof(variant));
+                // 48 distinct states, anything past that is a duplicate and comes back from the registry
+                static const VkCullModeFlags cullModes[4] = {VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_FRONT_AND_BACK};
+                variant.cullMode = cullModes[i % 4];
+                variant.frontFace = (i / 4) % 2 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+                variant.blendEnable = (i / 8) % 2 ? VK_TRUE : VK_FALSE;
+                // color modes are specializations of the same module
+                variant.specialization[SPEC_COLOR_MODE] = (options.colorMode + i / 16) % 3;
+                uint32_t handle;
+                if(pipelineRequest(&pipelines, &variant, &handle)) return -1;
+            }
+        }
+        if(pipeline == VK_NULL_HANDLE){
+            if(pipelineGet(&pipelines, scenePipeline, &pipeline)) return -1;
+            if(pipeline != VK_NULL_HANDLE) bench.pipelineMs = pipelines.entries[scenePipeline].readyMs - pipelines.entries[scenePipeline].requestMs;
+            else placeholderFrames++;
+        }
+        struct frameUniforms uniforms = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        if(frameDescriptorsUpdate(device, &frameDescriptors, frame, frameSlot, &uniforms)) return -1;
+        if(options.drawData == DRAW_DATA_UNIFORM && writeDrawUniforms(&instances, &drawUniforms, frame, frameSlot)) return -1;
+        uint64_t culled = 0;
+        if(asyncCompute && submitCulling(device, &sync, frame, &culler, frameSlot, &culled)) return -1;
+        if(options.cacheCommands){
+            // the instance data lives in the ring so animation alone never invalidates a recording
+            struct commandCacheKey key;
+            struct commandCacheEntry* entry;
+            uint32_t hit;
+            commandCacheMakeKey(&commandCache, sChainImageViews[imageIndex], renderPass, pipeline, imgInfo.swapChainExtent, instances.drawCount[frameSlot], &key);
+            if(commandCacheLookup(device, &commandCache, imageIndex, frameSlot, &key, &entry, &hit)) return -1;
+            // recorded inline, secondaries from the recording threads are reset every frame and cannot be kept
+            if(!hit && recordCommandBuffer(entry->commandBuffer, imageIndex, frameBuffers, renderPass, &rendering, swapChainImages, sChainImageViews,
+                &imgInfo, pipeline, &draws, NULL, &gpuTimer, frameSlot)) return -1;
+            frame->commandBuffer = entry->commandBuffer;
+        } else {
+            if(commandAllocatorGet(device, &frame->commands, &frame->commandBuffer)) return -1;
+            if(recordCommandBuffer(frame->commandBuffer, imageIndex, frameBuffers, renderPass, &rendering, swapChainImages, sChainImageViews, &imgInfo, pipeline, &draws,
+                options.recordThreads ? &recorder : NULL, &gpuTimer, frameSlot)) return -1;
+        }
+        phaseStart[PHASE_SUBMIT] = timeMs();
+        uint64_t streamed;
+        if(streamSubmit(&stream, &streamed)) return -1;
+        // images the transfer family released are acquired ahead of the frame's commands, in the same submit
+        VkCommandBuffer submitBuffers[2];
+        uint32_t submitCount = 0;
+        if(stream.acquireCount){
+            uint64_t acquired;
+            if(commandAllocatorGet(device, &frame->commands, submitBuffers) || streamRecordAcquires(&stream, submitBuffers[0], &acquired)) return -1;
+            if(acquired > streamed) streamed = acquired;
+            submitCount++;
+        }
+        submitBuffers[submitCount++] = frame->commandBuffer;
+        if(sceneTicket && !sceneMs){
+            sceneFrames++;
+            if(streamPoll(&stream, sceneTicket)){
+                sceneMs = timeMs() - loopStart;
+                // the texture went last, its acquire was recorded by this frame or an earlier one
+                if(options.bindless && bindlessAddTexture(device, &bindless, sceneTextureView) == UINT32_MAX) return -1;
+            }
+        }
+
+        // offscreen images are neither acquired nor presented so there is nothing to wait on or signal
+        struct syncWaits waits = {.count = 0};
+        if(!options.headless) syncWaitBinary(&waits, frame->imgAvailable, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        syncWaitTimeline(&waits, &sync, SYNC_COMPUTE, culled, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+        syncWaitTimeline(&waits, &sync, SYNC_TRANSFER, streamed, STREAM_WAIT_STAGES);
+        if(syncSubmit(&sync, SYNC_GRAPHICS, &waits, submitBuffers, submitCount, options.headless ? VK_NULL_HANDLE : frame->renderFinished, &frame->submitValue)) return -1;
+        imagesInFlight[imageIndex] = frame->submitValue;
+        phaseStart[PHASE_PRESENT] = timeMs();
+        if(!options.headless) {
+            uint64_t presentId = presentLatencyBegin(&latency, sampleMs);
+            VkPresentIdKHR presentIdInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                .swapchainCount = 1,
+                .pPresentIds = &presentId
+            };
+            VkPresentInfoKHR presentInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .pNext = presentId ? &presentIdInfo : NULL,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &frame->renderFinished,
+                .swapchainCount = 1,
+                .pSwapchains = &swapChain,
+                .pImageIndices = &imageIndex,
+                .pResults = NULL
+            };
+            presentLatencyLock(&latency);
+            VkResult presented = vkQueuePresentKHR(Queue.present,&presentInfo);
+            presentLatencyUnlock(&latency);
+            presentLatencyQueued(&latency, presentId);
+            if(presented == VK_ERROR_OUT_OF_DATE_KHR || presented == VK_SUBOPTIMAL_KHR){
+                if(!staleSince) staleSince = timeMs();
+            } else if(presented != VK_SUCCESS){
+                fprintf(stdout, "ERROR: FAILED TO PRESENT SWAPCHAIN IMAGE\n");
+                return -1;
+            } else if(resizeStart){
+                // first image shown on a swapchain that matches the window again
+                double latencyMs = timeMs() - resizeStart;
+                resize.latencyCount++;
+                resize.latencyMs += latencyMs;
+                if(latencyMs > resize.latencyMaxMs) resize.latencyMaxMs = latencyMs;
+                resizeStart = 0.0;
+            }
+        }
+        double frameEnd = timeMs();
+        if(options.framePacing) framePacerUpdate(&pacer, phaseStart[PHASE_PRESENT] - sampleMs + gpuTimerResult(&gpuTimer, "frame"));
+        if(options.bench && frameCount >= options.warmupFrames){
+            double phases[PHASE_COUNT];
+            for(int i = 0; i < PHASE_FRAME; i++) phases[i] = ((i + 1 < PHASE_FRAME) ? phaseStart[i + 1] : frameEnd) - phaseStart[i];
+            phases[PHASE_FRAME] = frameEnd - phaseStart[PHASE_WAIT];
+            phases[PHASE_GPU] = gpuTimerResult(&gpuTimer, "frame");
+            if(benchRecord(&bench, phases)) return -1;
+        }
+        frame->frameNumber = frameCount++;
     }
+    double loopTime = timeMs() - loopStart;
+    if(frameCount) fprintf(stdout, "Frames in flight: %u, average frame time: %.3f ms over %llu frames\n",
+        options.framesInFlight, loopTime / frameCount, (unsigned long long)frameCount);
+    double benchElapsed = timeMs() - benchStart;
+    destroyPresentLatency(&latency);
+    bench.latency = latency.samples;
+    bench.latencyCount = latency.sampleCount;
+    if(latency.sampleCount){
+        double latencySum = 0.0;
+        for(uint64_t i = 0; i < latency.sampleCount; i++) latencySum += latency.samples[i];
+        fprintf(stdout, "Input to display latency: %.3f ms on average over %llu frames (%s%s)\n", latencySum / latency.sampleCount,
+            (unsigned long long)latency.sampleCount, presentModeName(options.presentMode), options.framePacing ? ", low latency pacing" : "");
+    }
+    bench.resize = &resize;
+    bench.pipelines = &pipelines;
+    bench.placeholderFrames = placeholderFrames;
+    if(options.bench) benchReport(&bench, benchElapsed, &options);
+    if(resize.count) fprintf(stdout, "Swapchain (%s) recreated %u times in %.2f ms on average (max %.2f), stale to first present %.2f ms on average (max %.2f) at %.2f ms per frame\n",
+        options.dynamicRendering ? "dynamic rendering" : "render pass", resize.count, resize.recreateMs / resize.count, resize.recreateMaxMs, resize.latencyCount ? resize.latencyMs / resize.latencyCount : 0.0, resize.latencyMaxMs,
+        frameCount ? loopTime / frameCount : 0.0);
+    benchFree(&bench);
+    free(latency.samples);
+    vkDeviceWaitIdle(device);
 
-    vkDestroySemaphore(device, imgAvailableSemaphore, NULL);
-    vkDestroySemaphore(device, renderFinishedSemaphore, NULL);
-    vkDestroyFence(device, inFlightFence, NULL);
+    // after the frame loop so it neither adds to startup nor competes with culling for the compute queue
+    if(options.computeBenchMB){
+        struct computeContext compute;
+        if(createComputeContext(&allocator, physicalDevice, &deviceProps, &Queue, &sync, &compute) ||
+            computeBenchmark(&compute, &deviceProps, &descriptorCache, pipelineCache, options.computeBenchMB)) return -1;
+        destroyComputeContext(&compute);
+    }
+    if(options.streamMB){
+        if(sceneMs) fprintf(stdout, "Streamed scene: %u MB in %.2f ms over %llu frames\n", options.streamMB, sceneMs, (unsigned long long)sceneFrames);
+        else fprintf(stdout, "Streamed scene: %llu of %u MB done when the run ended\n", (unsigned long long)(stream.bytes >> 20), options.streamMB);
+    }
+    if(stream.submitted) fprintf(stdout, "Upload stream: %llu bytes in %llu batches, %llu copy commands for %llu regions, largest batch %llu bytes, %llu stalls on ring space or batches\n",
+        (unsigned long long)stream.bytes, (unsigned long long)stream.submitted, (unsigned long long)stream.copyCommands, (unsigned long long)stream.copyRegions,
+        (unsigned long long)stream.maxBatchBytes, (unsigned long long)stream.stalls);
+    destroyUploadStream(&allocator, &stream);
+    fprintf(stdout, "Timelines: %llu graphics, %llu compute and %llu transfer submissions, %llu host waits blocked\n",
+        (unsigned long long)sync.timelines[SYNC_GRAPHICS].submitted, (unsigned long long)sync.timelines[SYNC_COMPUTE].submitted,
+        (unsigned long long)sync.timelines[SYNC_TRANSFER].submitted, (unsigned long long)sync.hostWaits);
+    destroySyncLayer(&sync);
+    if(sceneBuffer != VK_NULL_HANDLE) destroyBuffer(&allocator, sceneBuffer, &sceneMemory);
+    free(sceneData);
+    if(sceneTexture != VK_NULL_HANDLE){
+        vkDestroyImageView(device, sceneTextureView, NULL);
+        vkDestroyImage(device, sceneTexture, NULL);
+        allocatorFree(&allocator, &sceneTextureMemory);
+    }
+    free(textureData);
+    if(gpuTimer.queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, gpuTimer.queryPool, NULL);
+    struct allocatorStats memStats;
+    allocatorGetStats(&allocator, &memStats);
+    fprintf(stdout, "Device memory: %u allocations backing %llu resources, %llu of %llu bytes used (%llu requested), fragmentation %.1f%%\n",
+        memStats.deviceMemoryCount, (unsigned long long)memStats.allocationCount, (unsigned long long)memStats.used,
+        (unsigned long long)memStats.reserved, (unsigned long long)memStats.requested, memStats.fragmentation * 100.0);
+    if(options.cullMode != CULL_MODE_OFF && frameCount){
+        uint32_t lastSlot = (frameCount - 1) % options.framesInFlight;
+        fprintf(stdout, "Culling on the %s: %u of %u objects visible in the last frame\n", options.cullMode == CULL_MODE_GPU ? "gpu" : "cpu",
+            options.cullMode == CULL_MODE_GPU ? cullerVisibleCount(&culler, lastSlot) : instances.drawCount[lastSlot], instances.instanceCount);
+    }
+    fprintf(stdout, "Descriptors: %u set layouts (%llu cache hits), frame uniforms %s, %llu descriptor writes while rendering\n", descriptorCache.count,
+        (unsigned long long)descriptorCache.hits, options.descriptorMode == DESCRIPTOR_MODE_DYNAMIC ? "at dynamic offsets" : "in sets written every frame",
+        (unsigned long long)frameDescriptors.setWrites);
+    if(options.bindless) fprintf(stdout, "Bindless: %u of %u storage buffers and %u of %u sampled images in use\n",
+        bindless.bufferCount, bindless.maxBuffers, bindless.textureCount, bindless.maxTextures);
+    if(options.drawData == DRAW_DATA_PUSH) fprintf(stdout, "Per-draw data: %u bytes of push constants per draw (limit %u)\n",
+        (uint32_t)sizeof(struct drawConstants), deviceProps.limits.maxPushConstantsSize);
+    if(options.drawData == DRAW_DATA_UNIFORM) fprintf(stdout, "Per-draw data: %u bytes per draw in the uniform ring at a %llu byte stride\n",
+        (uint32_t)sizeof(struct drawConstants), (unsigned long long)drawUniformStride(deviceProps.limits.minUniformBufferOffsetAlignment));
+    fprintf(stdout, "Pipelines: %u compiled from %u shader modules in %u batches on %u threads, %.2f ms compiling (longest batch %.2f ms), %llu of %llu requests deduplicated, %llu frames drawn without the scene\n",
+        pipelines.compiled, pipelines.moduleCount, pipelines.batches, options.pipelineThreads, pipelines.compileMs, pipelines.maxBatchMs, (unsigned long long)pipelines.hits,
+        (unsigned long long)pipelines.requests, (unsigned long long)placeholderFrames);
+    if(options.recordThreads) destroyRecordPool(&recorder);
+    if(options.cullMode == CULL_MODE_GPU) destroyCuller(&allocator, &culler);
+    destroyInstanceRing(&allocator, &instances);
+    destroyMesh(&allocator, &mesh);
+    if(options.cacheCommands){
+        fprintf(stdout, "Command cache: %llu hits, %llu misses\n", (unsigned long long)commandCache.hits, (unsigned long long)commandCache.misses);
+        destroyCommandCache(device, &commandCache);
+    }
+    uint64_t commandsAllocated = 0, commandsRecycled = 0;
+    for(uint32_t i = 0; i < options.framesInFlight; i++){
+        commandsAllocated += frames[i].commands.allocatedTotal;
+        commandsRecycled += frames[i].commands.recycledTotal;
+    }
+    if(frameCount) fprintf(stdout, "Command buffers: %llu allocated, %llu recycled, last frame allocated %u and recycled %u\n",
+        (unsigned long long)commandsAllocated, (unsigned long long)commandsRecycled,
+        frames[(frameCount - 1) % options.framesInFlight].commands.allocatedThisFrame, frames[(frameCount - 1) % options.framesInFlight].commands.recycledThisFrame);
+    destroyFrameDescriptors(device, &frameDescriptors);
+    if(options.drawData == DRAW_DATA_UNIFORM) destroyFrameDescriptors(device, &drawUniforms);
+    if(options.bindless) destroyBindlessTable(device, &bindless);
+    destroyFrameRing(device, &allocator, frames, options.framesInFlight);
+    destroyUploadContext(device, &upload);
     vkDestroyCommandPool(device, commandPool, NULL);
-    for(int i = 0; i < imgInfo.swapChainImageCount; i++) vkDestroyFramebuffer(device,frameBuffers[i], NULL);
-    vkDestroyPipeline(device, pipeline, NULL);
+    for(int i = 0; frameBuffers && i < imgInfo.swapChainImageCount; i++) vkDestroyFramebuffer(device,frameBuffers[i], NULL);
+    free(frameBuffers);
+    free(imagesInFlight);
+    destroyPipelineRegistry(&pipelines);
+    if(pipelineCache != VK_NULL_HANDLE){
+        savePipelineCache(device, pipelineCache, options.pipelineCachePath);
+        vkDestroyPipelineCache(device, pipelineCache, NULL);
+    }
     vkDestroyPipelineLayout(device, layout, NULL);
+    destroyDescriptorCache(&descriptorCache);
     vkDestroyRenderPass(device, renderPass, NULL);
     for(int i = 0; i < imgInfo.swapChainImageCount; i++) vkDestroyImageView(device,sChainImageViews[i], NULL);
 
     free(sChainImageViews);
+    if(options.headless){
+        for(int i = 0; i < imgInfo.swapChainImageCount; i++){
+            vkDestroyImage(device, swapChainImages[i], NULL);
+            allocatorFree(&allocator, offscreenMemory + i);
+        }
+        free(offscreenMemory);
+    }
     free(swapChainImages);
 
-    vkDestroySwapchainKHR(device,swapChain,NULL);
-    vkDestroySurfaceKHR(vulkan, surface, NULL);
+    if(!options.headless){
+        vkDestroySwapchainKHR(device,swapChain,NULL);
+        vkDestroySurfaceKHR(vulkan, surface, NULL);
+    }
+    destroyAllocator(&allocator);
     vkDestroyDevice(device, NULL);
 
     #ifdef DEBUG
@@ -174,8 +1460,10 @@ int main(){
     #endif
 
     vkDestroyInstance(vulkan, NULL);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if(window){
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
     return 0;
 }
 
@@ -185,22 +1473,34 @@ int main(){
 inline GLFWwindow* initWindow(){
     if(!glfwInit())return NULL;
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); //disable OpenGL since we're using vulkan
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); //disable resizing as it's too hard to deal with
-    return glfwCreateWindow(windowSize[0],windowSize[1],"fucking hell", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(windowSize[0],windowSize[1],"fucking hell", NULL, NULL);
+    if(window) glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    return window;
 }
 
-inline int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger){
+// drivers are not required to report VK_ERROR_OUT_OF_DATE_KHR after a resize, so the window tells us itself
+void framebufferResizeCallback(GLFWwindow* window, int width, int height){
+    framebufferResized = 1;
+}
+
+inline int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger, uint32_t headless){
+    // 1.3 where the loader has it so dynamic rendering is core, 1.1 loaders accept any version and 1.0 ones lack vkEnumerateInstanceVersion
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    PFN_vkEnumerateInstanceVersion enumerateVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+    if(enumerateVersion) enumerateVersion(&loaderVersion);
+    instanceApiVersion = loaderVersion >= VK_API_VERSION_1_3 ? VK_API_VERSION_1_3 : VK_API_VERSION_1_2;
     VkApplicationInfo appInfo = {
     .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
     .pApplicationName = "fucking hell",
     .applicationVersion = VK_MAKE_VERSION(1,0,0),
     .pEngineName = "No Engine",
     .engineVersion = VK_MAKE_VERSION(1,0,0),
-    .apiVersion = VK_API_VERSION_1_0,
+    .apiVersion = instanceApiVersion, // timeline semaphores at least, 1.1 devices fall back to VK_KHR_timeline_semaphore
     };
 
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = NULL; // glfw is never initialized when headless
+    if(!headless) glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
     uint32_t layerCount = 0;
     const char** layerNames = NULL;
@@ -236,7 +1536,7 @@ inline int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger)
     
     uint32_t instanceExtensionCount = glfwExtensionCount +1;
     const char* instanceExtensions[glfwExtensionCount+1];
-    memcpy(instanceExtensions,glfwExtensions,sizeof(const char*) *glfwExtensionCount);
+    if(glfwExtensionCount) memcpy(instanceExtensions,glfwExtensions,sizeof(const char*) *glfwExtensionCount);
     instanceExtensions[glfwExtensionCount] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
     #else
     uint32_t instanceExtensionCount = glfwExtensionCount;
@@ -264,7 +1564,32 @@ inline int initVulkan(VkInstance *instance, VkDebugUtilsMessengerEXT* messenger)
     return 0;
 }
 
-inline int pickPhysicalDevice(VkPhysicalDevice* device, VkInstance instance, VkSurfaceKHR surface){
+#define DEVICE_ENV "VULKAN_TEST_DEVICE" // same as --device, the option wins
+static inline const char* deviceTypeName(VkPhysicalDeviceType type){
+    switch(type){
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+        default: return "other";
+    }
+}
+
+// 32 hex digits, dashes anywhere are ignored
+static inline int parseDeviceUUID(const char* text, uint8_t* uuid){
+    uint32_t digits = 0;
+    for(const char* c = text; *c; c++){
+        if(*c == '-') continue;
+        int value = (*c >= '0' && *c <= '9') ? *c - '0' : (*c >= 'a' && *c <= 'f') ? *c - 'a' + 10 : (*c >= 'A' && *c <= 'F') ? *c - 'A' + 10 : -1;
+        if(value < 0 || digits == VK_UUID_SIZE * 2) return 1;
+        if(digits % 2 == 0) uuid[digits / 2] = value << 4;
+        else uuid[digits / 2] |= value;
+        digits++;
+    }
+    return digits != VK_UUID_SIZE * 2;
+}
+
+inline int pickPhysicalDevice(VkPhysicalDevice* device, VkInstance instance, VkSurfaceKHR surface, const char* forced, VkPhysicalDeviceProperties* props){
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance,&deviceCount, NULL);
     if(!deviceCount) {
@@ -273,25 +1598,124 @@ inline int pickPhysicalDevice(VkPhysicalDevice* device, VkInstance instance, VkS
     }
     VkPhysicalDevice devices[deviceCount];
     vkEnumeratePhysicalDevices(instance,&deviceCount, devices);
-    for(int i = 0; i < deviceCount; i++){
-        if(isDeviceSuitable(devices[i], surface)) {
+
+    if(forced == NULL) forced = getenv(DEVICE_ENV);
+    uint32_t forcedIndex = UINT32_MAX;
+    uint8_t forcedUUID[VK_UUID_SIZE];
+    uint32_t byUUID = 0;
+    if(forced != NULL){
+        char* end = NULL;
+        unsigned long index = strtoul(forced, &end, 10);
+        if(*forced != '\0' && *end == '\0') forcedIndex = (uint32_t)index;
+        else if(parseDeviceUUID(forced, forcedUUID) == 0) byUUID = 1;
+        else {
+            fprintf(stdout, "ERROR: DEVICE %s IS NEITHER AN INDEX NOR A UUID\n", forced);
+            return 1;
+        }
+    }
+
+    uint64_t bestScore = 0;
+    for(uint32_t i = 0; i < deviceCount; i++){
+        VkPhysicalDeviceIDProperties ids = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+        VkPhysicalDeviceProperties2 props2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &ids};
+        vkGetPhysicalDeviceProperties2(devices[i], &props2);
+        uint32_t suitable = isDeviceSuitable(devices[i], surface);
+        uint64_t score = suitable ? scoreDevice(devices[i], surface) : 0;
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        for(uint32_t j = 0; j < VK_UUID_SIZE; j++) snprintf(uuid + j * 2, 3, "%02x", ids.deviceUUID[j]);
+        if(suitable) fprintf(stdout, "Device %u: %s (%s, %s), score %llu\n", i, props2.properties.deviceName, deviceTypeName(props2.properties.deviceType), uuid, (unsigned long long)score);
+        else fprintf(stdout, "Device %u: %s (%s, %s), unsuitable\n", i, props2.properties.deviceName, deviceTypeName(props2.properties.deviceType), uuid);
+
+        if(forced != NULL){
+            if(i != forcedIndex && !(byUUID && memcmp(ids.deviceUUID, forcedUUID, VK_UUID_SIZE) == 0)) continue;
+            if(!suitable){
+                fprintf(stdout, "ERROR: FORCED DEVICE %s CANNOT RUN THIS APPLICATION\n", forced);
+                return 1;
+            }
+            *device = devices[i];
+        } else if(suitable && score > bestScore){
+            // ties keep the earlier device, the order the driver reports
+            bestScore = score;
             *device = devices[i];
-            break;
         }
     }
     if(*device == VK_NULL_HANDLE) {
-        fprintf(stdout, "ERROR: No Suitable Device Found\n");
+        if(forced != NULL) fprintf(stdout, "ERROR: NO DEVICE MATCHES %s\n", forced);
+        else fprintf(stdout, "ERROR: No Suitable Device Found\n");
         return 1;
     }
+    vkGetPhysicalDeviceProperties(*device, props);
     #ifdef DEBUG
-    VkPhysicalDeviceProperties props;
-    vkGetPhysicalDeviceProperties(*device, &props);
-    fprintf(stdout, "Selected Device Name: %s\n", props.deviceName);
-    fprintf(stdout, "Selected Device Type: %d\n", props.deviceType);
+    fprintf(stdout, "Selected Device Name: %s\n", props->deviceName);
+    fprintf(stdout, "Selected Device Type: %d\n", props->deviceType);
     #endif
     return 0;
 }
 
+struct scoredExtension {
+    const char* name;
+    uint64_t score;
+    uint32_t needsSurface;
+};
+// optional extensions the application makes use of when they are there
+const struct scoredExtension scoredExtensions[] = {
+    {VK_KHR_PRESENT_ID_EXTENSION_NAME, 50, 1},
+    {VK_KHR_PRESENT_WAIT_EXTENSION_NAME, 50, 1},
+    {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, 50, 0}
+};
+
+// higher is better, only meaningful for devices that passed isDeviceSuitable
+// the device type outweighs everything else, the rest decides between devices of one type
+static inline uint64_t scoreDevice(VkPhysicalDevice device, VkSurfaceKHR surface){
+    VkPhysicalDeviceProperties props;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memory;
+    vkGetPhysicalDeviceProperties(device, &props);
+    vkGetPhysicalDeviceFeatures(device, &features);
+    vkGetPhysicalDeviceMemoryProperties(device, &memory);
+    uint64_t score = 1; // suitable devices never score 0
+    switch(props.deviceType){
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 10000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 5000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 2000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 500; break;
+        default: break;
+    }
+    // largest device-local heap, 1 point per 8MB up to 16GB
+    VkDeviceSize heapSize = 0;
+    for(uint32_t i = 0; i < memory.memoryHeapCount; i++){
+        if((memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memory.memoryHeaps[i].size > heapSize) heapSize = memory.memoryHeaps[i].size;
+    }
+    score += (heapSize >> 23) < 2048 ? (heapSize >> 23) : 2048;
+
+    // families without graphics let transfers and compute run beside rendering
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties queueFamilies[queueFamilyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
+    uint32_t asyncCompute = 0, dedicatedTransfer = 0, presentsFromGraphics = 0;
+    for(uint32_t i = 0; i < queueFamilyCount; i++){
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) asyncCompute = 1;
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) dedicatedTransfer = 1;
+        VkBool32 presentSupp = VK_FALSE;
+        if(surface != VK_NULL_HANDLE && (flags & VK_QUEUE_GRAPHICS_BIT)) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupp);
+        if(presentSupp) presentsFromGraphics = 1;
+    }
+    score += asyncCompute * 300 + dedicatedTransfer * 300 + presentsFromGraphics * 200;
+
+    for(uint32_t i = 0; i < sizeof(scoredExtensions) / sizeof(scoredExtensions[0]); i++){
+        if(scoredExtensions[i].needsSurface && surface == VK_NULL_HANDLE) continue;
+        if(deviceExtensionSupported(device, scoredExtensions[i].name)) score += scoredExtensions[i].score;
+    }
+    // gpu culling needs both
+    if(features.multiDrawIndirect && features.drawIndirectFirstInstance) score += 200;
+    score += props.limits.maxImageDimension2D / 1024;
+    if(props.limits.maxPushConstantsSize >= 256) score += 50;
+    if(props.limits.timestampComputeAndGraphics) score += 50;
+    return score;
+}
+
 static inline int checkDeviceExtensionSupport(VkPhysicalDevice device){
     uint32_t extensionCount = 0;
     if(vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL) != VK_SUCCESS) return 1;
@@ -302,7 +1726,7 @@ static inline int checkDeviceExtensionSupport(VkPhysicalDevice device){
     for (int i = 0; i < extensionCount; i++)
     {
         for(int j = 0; j < requiredExtensionCount; j++){
-            if(strcmp(availableExtensions[i].extensionName,requiredExtensions[j])){
+            if(strcmp(availableExtensions[i].extensionName,requiredExtensions[j]) == 0){
                 requiredExtensions[j] = requiredExtensions[--requiredExtensionCount];
                 break;
             }
@@ -312,12 +1736,26 @@ static inline int checkDeviceExtensionSupport(VkPhysicalDevice device){
     return requiredExtensionCount;
 }
 
+static inline int deviceExtensionSupported(VkPhysicalDevice device, const char* name){
+    uint32_t extensionCount = 0;
+    if(vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL) != VK_SUCCESS) return 0;
+    VkExtensionProperties availableExtensions[extensionCount];
+    if(vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availableExtensions) != VK_SUCCESS) return 0;
+    for(uint32_t i = 0; i < extensionCount; i++){
+        if(strcmp(availableExtensions[i].extensionName, name) == 0) return 1;
+    }
+    return 0;
+}
+
+// hard requirements only, how well a device fits is up to scoreDevice
 inline int isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface){
-    VkPhysicalDeviceProperties props;
-    VkPhysicalDeviceFeatures features;
-    vkGetPhysicalDeviceProperties(device, &props);
-    vkGetPhysicalDeviceFeatures(device, &features);
-    uint32_t deviceFlag =(props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) & (features.geometryShader);
+    if(surface == VK_NULL_HANDLE){
+        // headless only needs a graphics queue and timelines, software rasterizers like lavapipe are fine
+        struct QueueFamilyIndices indices;
+        return findQueueFamilies(device, &indices, &surface) == 0 && timelineSemaphoreSupported(device);
+    }
+    struct QueueFamilyIndices indices;
+    uint32_t queueFlag = (findQueueFamilies(device, &indices, &surface) == 0);
     VkBool32 presentFlag = 0;
     uint32_t queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(device,&queueFamilyCount, NULL);
@@ -334,33 +1772,45 @@ inline int isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface){
         uint32_t surfaceFlag = (formatCount != 0) & (presentModeCount != 0);
         swapChainFlag &= surfaceFlag;
     }
-    return presentFlag & deviceFlag & swapChainFlag;
+    return presentFlag & queueFlag & swapChainFlag & timelineSemaphoreSupported(device);
 }
 
 inline int findQueueFamilies(VkPhysicalDevice physicalDevice, struct QueueFamilyIndices* indices, VkSurfaceKHR* surface){
     indices->Flags = 0;
-    uint32_t exitFlag = 1;
+    indices->presentFlag = 0;
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
     VkQueueFamilyProperties queueFamilyProperties[queueFamilyCount];
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties);
+    uint32_t graphicsPresents = 0;
+    uint32_t transferFamily = UINT32_MAX, computeFamily = UINT32_MAX;
     for(int i = 0; i < queueFamilyCount; i++){
+        VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
         VkBool32 presentSupp = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, *surface, &presentSupp);
-        if(presentSupp){
+        if(*surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, *surface, &presentSupp);
+        if(presentSupp && !indices->presentFlag){
             indices->presentFamily = i;
             indices->presentFlag = 1;
         }
-        if(queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        // a graphics family that can also present saves the ownership juggling between two queues
+        if((flags & VK_QUEUE_GRAPHICS_BIT) && (!(indices->Flags & VK_QUEUE_GRAPHICS_BIT) || (presentSupp && !graphicsPresents))) {
             indices->graphicsFamily = i;
             indices->Flags |= VK_QUEUE_GRAPHICS_BIT;
+            graphicsPresents = presentSupp;
         }
-        if((indices->Flags == queuesNeeded) & (indices->presentFlag)){
-            exitFlag = 0;
-            break;
-        }
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && transferFamily == UINT32_MAX) transferFamily = i;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && computeFamily == UINT32_MAX) computeFamily = i;
+    }
+    if(!(indices->Flags & VK_QUEUE_GRAPHICS_BIT)) return 1;
+    // without a surface nothing is presented, the graphics queue stands in for the present queue
+    if(graphicsPresents || *surface == VK_NULL_HANDLE){
+        indices->presentFamily = indices->graphicsFamily;
+        indices->presentFlag = 1;
     }
-    return exitFlag;
+    // the graphics family can do everything, it takes over whatever has no family of its own
+    indices->transferFamily = transferFamily != UINT32_MAX ? transferFamily : indices->graphicsFamily;
+    indices->computeFamily = computeFamily != UINT32_MAX ? computeFamily : indices->graphicsFamily;
+    return !((indices->Flags == queuesNeeded) & (indices->presentFlag));
 }
 
 uint32_t filterRepeated(uint32_t* indexes, uint32_t size){
@@ -379,14 +1829,14 @@ uint32_t filterRepeated(uint32_t* indexes, uint32_t size){
     return size - offset;
 }
 
-#define QUEUE_COUNT 2
-inline int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance instance, VkDevice* device, struct qHandles* queue, VkSurfaceKHR* surface){
+#define QUEUE_COUNT 4
+inline int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance instance, VkDevice* device, struct qHandles* queue, VkSurfaceKHR* surface, VkPhysicalDeviceFeatures* enabled, uint32_t* presentWait, uint32_t* dynamicRendering, uint32_t* descriptorIndexing){
     struct QueueFamilyIndices indices;
     if(findQueueFamilies(physicalDevice,&indices,surface)){
         printf("CRITICAL ERROR: QUEUE FAMILIES NOT FOUND\n");
         return 1;
     }
-    uint32_t queueIndexes[QUEUE_COUNT] = {indices.graphicsFamily, indices.presentFamily};
+    uint32_t queueIndexes[QUEUE_COUNT] = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily, indices.computeFamily};
     uint32_t queueCount = filterRepeated(queueIndexes, QUEUE_COUNT);
 #undef QUEUE_COUNT
 
@@ -394,18 +1844,69 @@ inline int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance insta
     VkDeviceQueueCreateInfo* queueCreateInfo = (VkDeviceQueueCreateInfo*)malloc(sizeof(VkDeviceQueueCreateInfo)*queueCount);
     for(int i = 0; i < queueCount; i++){
         queueCreateInfo[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo[i].pNext = NULL;
         queueCreateInfo[i].queueCount = 1;
         queueCreateInfo[i].pQueuePriorities = &queuePriority;
         queueCreateInfo[i].queueFamilyIndex = queueIndexes[i];
         queueCreateInfo[i].flags = VK_FALSE;
     }
 
+    // only optional features are enabled, callers check enabled before relying on them
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
     VkPhysicalDeviceFeatures deviceFeatures = {VK_FALSE};
-    uint32_t deviceExtensionCount = 1;
-    const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    deviceFeatures.multiDrawIndirect = supported.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+    *enabled = deviceFeatures;
+    // present ids and waits tell when a frame actually reached the display, used to measure latency and pace frames
+    *presentWait = 0;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR, .pNext = &presentWaitFeatures};
+    if(*surface != VK_NULL_HANDLE && deviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        deviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)){
+        VkPhysicalDeviceFeatures2 features2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &presentIdFeatures};
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        *presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+    }
+    // isDeviceSuitable made sure timelines are there, through the extension on 1.1 devices
+    uint32_t apiVersion = deviceApiVersion(physicalDevice);
+    // always enabled when there, whether it is used is up to the caller
+    *dynamicRendering = dynamicRenderingSupported(physicalDevice);
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+        .pNext = *presentWait ? &presentIdFeatures : NULL,
+        .dynamicRendering = VK_TRUE
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .pNext = *dynamicRendering ? (void*)&dynamicRenderingFeatures : *presentWait ? (void*)&presentIdFeatures : NULL,
+        .timelineSemaphore = VK_TRUE
+    };
+    // only what the bindless table uses
+    *descriptorIndexing = descriptorIndexingSupported(physicalDevice);
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        .pNext = &timelineFeatures,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE
+    };
+    uint32_t deviceExtensionCount = 0;
+    const char* deviceExtensions[6];
+    if(*surface != VK_NULL_HANDLE) deviceExtensions[deviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME; // swapchains are only needed with a surface
+    if(*presentWait){
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    }
+    if(apiVersion < VK_API_VERSION_1_2) deviceExtensions[deviceExtensionCount++] = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+    if(*dynamicRendering && apiVersion < VK_API_VERSION_1_3) deviceExtensions[deviceExtensionCount++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+    if(*descriptorIndexing && apiVersion < VK_API_VERSION_1_2) deviceExtensions[deviceExtensionCount++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
 
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = *descriptorIndexing ? (void*)&indexingFeatures : (void*)&timelineFeatures,
         .pQueueCreateInfos = queueCreateInfo,
         .queueCreateInfoCount = queueCount,
         .pEnabledFeatures = &deviceFeatures,
@@ -422,9 +1923,16 @@ inline int createLogicalDevice(VkPhysicalDevice physicalDevice, VkInstance insta
     fprintf(stdout, "DEBUG: Device Creation Succesful\n");
 #endif
     vkGetDeviceQueue(*device,indices.graphicsFamily,0,&(queue->graphics));
-    fprintf(stdout, "DEBUG: Got 1st queue\n");
-    vkGetDeviceQueue(*device,indices.presentFamily,0,&(queue->graphics));
-    fprintf(stdout, "DEBUG: Got 2nd queue\n");
+    vkGetDeviceQueue(*device,indices.presentFamily,0,&(queue->present));
+    vkGetDeviceQueue(*device,indices.transferFamily,0,&(queue->transfer));
+    vkGetDeviceQueue(*device,indices.computeFamily,0,&(queue->compute));
+    queue->graphicsFamily = indices.graphicsFamily;
+    queue->presentFamily = indices.presentFamily;
+    queue->transferFamily = indices.transferFamily;
+    queue->computeFamily = indices.computeFamily;
+    fprintf(stdout, "Queue families: graphics %u, present %u, transfer %u%s, compute %u%s\n", indices.graphicsFamily, indices.presentFamily,
+        indices.transferFamily, indices.transferFamily != indices.graphicsFamily ? " (dedicated)" : "",
+        indices.computeFamily, indices.computeFamily != indices.graphicsFamily ? " (async)" : "");
 
     free(queueCreateInfo);
     return 0;
@@ -440,7 +1948,30 @@ static inline VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKH
     return formats[0];
 }
 
-static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkImage** image, struct sChainImgInfo* imgInfo, VkSwapchainKHR* swapChain){
+static inline const char* presentModeName(VkPresentModeKHR mode){
+    for(uint32_t i = 0; i < PRESENT_MODE_COUNT; i++){
+        if(presentModeNames[i].mode == mode) return presentModeNames[i].name;
+    }
+    return "unknown";
+}
+
+// FIFO is the only mode every surface has to support, so it ends every fallback chain
+static inline VkPresentModeKHR choosePresentMode(const VkPresentModeKHR* modes, uint32_t count, VkPresentModeKHR requested){
+    VkPresentModeKHR chain[3] = {requested, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    // tearing or not, the other low latency mode is closer to what was asked for than FIFO
+    if(requested == VK_PRESENT_MODE_MAILBOX_KHR) chain[1] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if(requested == VK_PRESENT_MODE_IMMEDIATE_KHR) chain[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+    for(uint32_t i = 0; i < 3; i++){
+        for(uint32_t j = 0; j < count; j++){
+            if(modes[j] != chain[i]) continue;
+            if(i) fprintf(stdout, "WARNING: PRESENT MODE %s NOT SUPPORTED, USING %s\n", presentModeName(requested), presentModeName(chain[i]));
+            return chain[i];
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkImage** image, struct sChainImgInfo* imgInfo, VkExtent2D framebufferExtent, VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapChain, VkSwapchainKHR* swapChain){
     //get format info
     uint32_t formatCount;
     vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice,surface,&formatCount,NULL);
@@ -448,11 +1979,20 @@ static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR
     vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice,surface,&formatCount,formats);
     VkSurfaceFormatKHR format = chooseSwapSurfaceFormat(formats, formatCount);
     //choose Presentation Mode
-    VkPresentModeKHR presMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, NULL);
+    VkPresentModeKHR presentModes[presentModeCount];
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes);
+    VkPresentModeKHR presMode = choosePresentMode(presentModes, presentModeCount, presentMode);
     //choose ImageSize
     VkSurfaceCapabilitiesKHR capabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice,surface,&capabilities);
     VkExtent2D extent = capabilities.currentExtent;
+    if(extent.width == UINT32_MAX){
+        // the surface takes its size from the swapchain, follow the window's framebuffer
+        extent.width = fmin(fmax(framebufferExtent.width, capabilities.minImageExtent.width), capabilities.maxImageExtent.width);
+        extent.height = fmin(fmax(framebufferExtent.height, capabilities.minImageExtent.height), capabilities.maxImageExtent.height);
+    }
     uint32_t imageCount = capabilities.minImageCount +1;
     if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
     imageCount = capabilities.maxImageCount;
@@ -480,13 +2020,13 @@ static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR
         .imageArrayLayers = 1,
         .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
         .imageSharingMode = sharMode,
-        .queueFamilyIndexCount = 0,
+        .queueFamilyIndexCount = indexCount,
         .pQueueFamilyIndices = familyIndices,
         .preTransform = capabilities.currentTransform,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = presMode,
         .clipped = VK_TRUE,
-        .oldSwapchain = VK_NULL_HANDLE
+        .oldSwapchain = oldSwapChain // lets the driver reuse resources and keep presenting from it until the switch
     };
 
     if(vkCreateSwapchainKHR(device,&createInfo, NULL, swapChain) != VK_SUCCESS){
@@ -503,34 +2043,391 @@ static inline int createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR
     vkGetSwapchainImagesKHR(device,*swapChain, &swapImgCount, *image);
     imgInfo->swapChainExtent = extent;
     imgInfo->swapChainImageFormat = format.format;
-    imgInfo->swapChainImageCount = imageCount;
+    imgInfo->swapChainImageCount = swapImgCount; // may be more than requested
+    imgInfo->finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    imgInfo->presentMode = presMode;
     return 0;
 }
 
-static inline int createImageViews(VkDevice device, VkImageView** imageViews, VkImage** images, struct sChainImgInfo* imgInfo){ 
-    uint32_t imageCount = imgInfo->swapChainImageCount;
-    if((*imageViews = realloc(*imageViews, sizeof(VkImageView)*imageCount)) == NULL) {
-        fprintf(stdout, "ERROR: IMAGE VIEW REALLOC FAILED\n");
+// rebuilds everything sized by the swapchain, render pass and pipeline are kept since viewport and scissor are dynamic
+static inline int recreateSwapChain(GLFWwindow* window, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, struct syncLayer* sync, VkRenderPass renderPass,
+    struct presentLatency* latency, VkSwapchainKHR* swapChain, VkImage** images, VkImageView** imageViews, VkFramebuffer** frameBuffers, uint64_t** imagesInFlight, struct sChainImgInfo* imgInfo){
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    // a minimized window has nothing to render to, sleep until it is restored or closed
+    while((width == 0 || height == 0) && !glfwWindowShouldClose(window)){
+        glfwWaitEvents();
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+    if(width == 0 || height == 0) return 0;
+    // only graphics work can still reference the old views and framebuffers, compute and transfer keep running
+    if(syncWait(sync, SYNC_GRAPHICS, sync->timelines[SYNC_GRAPHICS].submitted)) return 1;
+    // with dynamic rendering there is no render pass and the views are all there is to rebuild
+    for(uint32_t i = 0; i < imgInfo->swapChainImageCount; i++){
+        if(renderPass != VK_NULL_HANDLE) vkDestroyFramebuffer(device, (*frameBuffers)[i], NULL);
+        vkDestroyImageView(device, (*imageViews)[i], NULL);
+    }
+    VkFormat format = imgInfo->swapChainImageFormat;
+    VkSwapchainKHR oldSwapChain = *swapChain;
+    // the old swapchain is retired by the new one, so the waiter thread must let go of it first
+    presentLatencyLock(latency);
+    int failed = createSwapChain(physicalDevice, surface, device, images, imgInfo, (VkExtent2D){width, height}, imgInfo->presentMode, oldSwapChain, swapChain);
+    if(!failed) presentLatencySetSwapChain(latency, *swapChain);
+    presentLatencyUnlock(latency);
+    if(failed) return 1;
+    vkDestroySwapchainKHR(device, oldSwapChain, NULL); // retired by the new one, its images are no longer acquired
+    if(imgInfo->swapChainImageFormat != format){
+        fprintf(stdout, "ERROR: SWAPCHAIN FORMAT CHANGED, PIPELINE NO LONGER COMPATIBLE\n");
         return 1;
     }
-    for(int i = 0; i < imageCount; i++){
-        VkImageViewCreateInfo createInfo = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = (*images)[i],
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = imgInfo->swapChainImageFormat,
-            .components = {
-                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .a = VK_COMPONENT_SWIZZLE_IDENTITY
-            },
-            .subresourceRange = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1
+    if(createImageViews(device, imageViews, images, imgInfo)) return 1;
+    if((renderPass != VK_NULL_HANDLE && (*frameBuffers = realloc(*frameBuffers, sizeof(VkFramebuffer) * imgInfo->swapChainImageCount)) == NULL) ||
+        (*imagesInFlight = realloc(*imagesInFlight, sizeof(uint64_t) * imgInfo->swapChainImageCount)) == NULL){
+        fprintf(stdout, "ERROR: SWAPCHAIN REALLOC FAILED\n");
+        return 1;
+    }
+    for(uint32_t i = 0; i < imgInfo->swapChainImageCount; i++) (*imagesInFlight)[i] = 0;
+    if(renderPass == VK_NULL_HANDLE) return 0;
+    return createFrameBuffers(device, imgInfo, imageViews, &renderPass, *frameBuffers);
+}
+
+static inline int createAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkPhysicalDeviceProperties* props, struct gpuAllocator* allocator){
+    memset(allocator, 0, sizeof(*allocator));
+    allocator->device = device;
+    allocator->maxAllocations = props->limits.maxMemoryAllocationCount;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &allocator->memProps);
+    return 0;
+}
+
+// blocks take at most an eighth of their heap so small heaps (e.g. host visible vram windows) are not exhausted by one block
+static inline VkDeviceSize allocatorBlockSize(struct gpuAllocator* allocator, uint32_t memoryType){
+    VkDeviceSize heapSize = allocator->memProps.memoryHeaps[allocator->memProps.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize size = ALLOCATOR_BLOCK_SIZE;
+    while(size > ALLOCATOR_MIN_SIZE && size > heapSize / 8) size /= 2;
+    return size;
+}
+
+static inline int allocatorNewBlock(struct gpuAllocator* allocator, uint32_t memoryType, VkDeviceSize size, uint32_t linear, uint32_t dedicated, uint32_t* blockIndex){
+    if(allocator->memoryCount >= allocator->maxAllocations){
+        fprintf(stdout, "ERROR: maxMemoryAllocationCount OF %u REACHED\n", allocator->maxAllocations);
+        return 1;
+    }
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType
+    };
+    VkDeviceMemory memory;
+    if(vkAllocateMemory(allocator->device, &allocInfo, NULL, &memory) != VK_SUCCESS) return 1; // the caller tries the next memory type
+
+    uint32_t index = 0;
+    while(index < allocator->blockCount && allocator->blocks[index].memory != VK_NULL_HANDLE) index++;
+    if(index == allocator->blockCount){
+        struct memBlock* blocks = realloc(allocator->blocks, sizeof(struct memBlock) * (allocator->blockCount + 1));
+        if(blocks == NULL){
+            fprintf(stdout, "ERROR: MEMORY BLOCK REALLOC FAILED\n");
+            vkFreeMemory(allocator->device, memory, NULL);
+            return 1;
+        }
+        allocator->blocks = blocks;
+        allocator->blockCount++;
+    }
+    struct memBlock* block = allocator->blocks + index;
+    memset(block, 0, sizeof(*block));
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->linear = linear;
+    if(!dedicated){
+        while((ALLOCATOR_MIN_SIZE << block->levels) <= size) block->levels++;
+        if((block->longest = malloc((1u << block->levels) - 1)) == NULL){
+            fprintf(stdout, "ERROR: BUDDY TREE MALLOC FAILED\n");
+            vkFreeMemory(allocator->device, memory, NULL);
+            block->memory = VK_NULL_HANDLE;
+            return 1;
+        }
+        // every node starts out as one free buddy of its own order
+        for(uint32_t depth = 0; depth < block->levels; depth++){
+            memset(block->longest + (1u << depth) - 1, block->levels - depth, 1u << depth);
+        }
+    }
+    if(allocator->memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        if(vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS){
+            fprintf(stdout, "ERROR: FAILED TO MAP MEMORY BLOCK\n");
+            free(block->longest);
+            vkFreeMemory(allocator->device, memory, NULL);
+            block->memory = VK_NULL_HANDLE;
+            return 1;
+        }
+    }
+    allocator->memoryCount++;
+    *blockIndex = index;
+    return 0;
+}
+
+// descends towards the smallest free buddy that fits, buddies are aligned to their own size
+static inline int buddyAlloc(struct memBlock* block, uint32_t order, VkDeviceSize* offset){
+    uint8_t* longest = block->longest;
+    if(order >= block->levels || longest[0] < order + 1) return 1;
+    uint32_t node = 0;
+    for(uint32_t nodeOrder = block->levels - 1; nodeOrder != order; nodeOrder--){
+        uint32_t left = node * 2 + 1;
+        uint32_t right = left + 1;
+        if(longest[left] < order + 1) node = right;
+        else if(longest[right] < order + 1) node = left;
+        else node = (longest[right] < longest[left]) ? right : left;
+    }
+    longest[node] = 0;
+    uint32_t depth = block->levels - 1 - order;
+    *offset = (VkDeviceSize)(node - ((1u << depth) - 1)) * (ALLOCATOR_MIN_SIZE << order);
+    while(node){
+        node = (node - 1) / 2;
+        uint8_t left = longest[node * 2 + 1], right = longest[node * 2 + 2];
+        longest[node] = left > right ? left : right;
+    }
+    return 0;
+}
+
+static inline void buddyFree(struct memBlock* block, VkDeviceSize offset, uint32_t order){
+    uint8_t* longest = block->longest;
+    uint32_t depth = block->levels - 1 - order;
+    uint32_t node = ((1u << depth) - 1) + (uint32_t)(offset / (ALLOCATOR_MIN_SIZE << order));
+    longest[node] = order + 1;
+    uint32_t nodeOrder = order;
+    while(node){
+        node = (node - 1) / 2;
+        nodeOrder++;
+        uint8_t left = longest[node * 2 + 1], right = longest[node * 2 + 2];
+        // two whole free children merge back into one buddy
+        if(left == nodeOrder && right == nodeOrder) longest[node] = nodeOrder + 1;
+        else longest[node] = left > right ? left : right;
+    }
+}
+
+static inline void allocatorFill(struct gpuAllocator* allocator, uint32_t blockIndex, VkDeviceSize offset, VkDeviceSize size, uint32_t order, VkDeviceSize requested, struct gpuAllocation* allocation){
+    struct memBlock* block = allocator->blocks + blockIndex;
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->mapped = block->mapped ? (char*)block->mapped + offset : NULL;
+    allocation->block = blockIndex;
+    allocation->order = order;
+    block->used += size;
+    block->allocationCount++;
+    allocator->allocationCount++;
+    allocator->requested += requested;
+}
+
+// linear is 1 for buffers and linear images, 0 for optimally tiled images
+static inline int allocatorAlloc(struct gpuAllocator* allocator, VkMemoryRequirements* memReq, VkMemoryPropertyFlags properties, uint32_t linear, struct gpuAllocation* allocation){
+    VkDeviceSize size = memReq->size > memReq->alignment ? memReq->size : memReq->alignment;
+    uint32_t order = 0;
+    while((ALLOCATOR_MIN_SIZE << order) < size) order++;
+    VkPhysicalDeviceMemoryProperties* memProps = &allocator->memProps;
+
+    // reuse free space in existing blocks first, memory types are tried in the driver's order of preference
+    for(uint32_t type = 0; type < memProps->memoryTypeCount; type++){
+        if(!(memReq->memoryTypeBits & (1u << type)) || (memProps->memoryTypes[type].propertyFlags & properties) != properties) continue;
+        for(uint32_t i = 0; i < allocator->blockCount; i++){
+            struct memBlock* block = allocator->blocks + i;
+            VkDeviceSize offset;
+            if(block->memory == VK_NULL_HANDLE || !block->levels || block->memoryType != type || block->linear != linear) continue;
+            if(buddyAlloc(block, order, &offset)) continue;
+            allocatorFill(allocator, i, offset, ALLOCATOR_MIN_SIZE << order, order, memReq->size, allocation);
+            return 0;
+        }
+    }
+    for(uint32_t type = 0; type < memProps->memoryTypeCount; type++){
+        if(!(memReq->memoryTypeBits & (1u << type)) || (memProps->memoryTypes[type].propertyFlags & properties) != properties) continue;
+        VkDeviceSize blockSize = allocatorBlockSize(allocator, type);
+        // anything bigger than a quarter block would waste most of it, those get their own VkDeviceMemory
+        uint32_t dedicated = (ALLOCATOR_MIN_SIZE << order) > blockSize / 4;
+        uint32_t blockIndex;
+        VkDeviceSize offset = 0;
+        if(allocatorNewBlock(allocator, type, dedicated ? memReq->size : blockSize, linear, dedicated, &blockIndex)) continue;
+        if(!dedicated && buddyAlloc(allocator->blocks + blockIndex, order, &offset)) continue;
+        allocatorFill(allocator, blockIndex, offset, dedicated ? memReq->size : (ALLOCATOR_MIN_SIZE << order), order, memReq->size, allocation);
+        return 0;
+    }
+    fprintf(stdout, "ERROR: DEVICE MEMORY ALLOCATION OF %llu BYTES FAILED\n", (unsigned long long)memReq->size);
+    return 1;
+}
+
+static inline void allocatorFree(struct gpuAllocator* allocator, struct gpuAllocation* allocation){
+    if(allocation->memory == VK_NULL_HANDLE) return;
+    struct memBlock* block = allocator->blocks + allocation->block;
+    block->used -= allocation->size;
+    block->allocationCount--;
+    allocator->allocationCount--;
+    if(block->levels) buddyFree(block, allocation->offset, allocation->order);
+    else {
+        vkFreeMemory(allocator->device, block->memory, NULL);
+        block->memory = VK_NULL_HANDLE;
+        allocator->memoryCount--;
+    }
+    allocation->memory = VK_NULL_HANDLE;
+}
+
+static inline void allocatorGetStats(struct gpuAllocator* allocator, struct allocatorStats* stats){
+    memset(stats, 0, sizeof(*stats));
+    VkDeviceSize freeBytes = 0;
+    for(uint32_t i = 0; i < allocator->blockCount; i++){
+        struct memBlock* block = allocator->blocks + i;
+        if(block->memory == VK_NULL_HANDLE) continue;
+        stats->deviceMemoryCount++;
+        stats->reserved += block->size;
+        stats->used += block->used;
+        if(!block->levels) continue;
+        freeBytes += block->size - block->used;
+        VkDeviceSize largest = block->longest[0] ? (ALLOCATOR_MIN_SIZE << (block->longest[0] - 1)) : 0;
+        if(largest > stats->largestFree) stats->largestFree = largest;
+    }
+    stats->allocationCount = allocator->allocationCount;
+    stats->requested = allocator->requested;
+    stats->fragmentation = freeBytes ? 1.0 - (double)stats->largestFree / freeBytes : 0.0;
+}
+
+static inline void destroyAllocator(struct gpuAllocator* allocator){
+    for(uint32_t i = 0; i < allocator->blockCount; i++){
+        if(allocator->blocks[i].memory == VK_NULL_HANDLE) continue;
+        free(allocator->blocks[i].longest);
+        vkFreeMemory(allocator->device, allocator->blocks[i].memory, NULL);
+    }
+    free(allocator->blocks);
+    allocator->blocks = NULL;
+    allocator->blockCount = 0;
+}
+
+static inline int createBuffer(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, struct gpuAllocation* allocation){
+    return createSharedBuffer(allocator, size, usage, properties, NULL, 0, buffer, allocation);
+}
+
+// with more than one distinct family the buffer is concurrent and needs no ownership transfers, for data no queue ever writes
+static inline int createSharedBuffer(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const uint32_t* families, uint32_t familyCount, VkBuffer* buffer, struct gpuAllocation* allocation){
+    uint32_t concurrent = familyCount > 1 && families[0] != families[1];
+    VkBufferCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = concurrent ? familyCount : 0,
+        .pQueueFamilyIndices = concurrent ? families : NULL
+    };
+    if(vkCreateBuffer(allocator->device, &createInfo, NULL, buffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: BUFFER CREATION FAILED\n");
+        return 1;
+    }
+    VkMemoryRequirements memReq;
+    vkGetBufferMemoryRequirements(allocator->device, *buffer, &memReq);
+    // on failure the handles are left null so callers may destroy them unconditionally
+    if(allocatorAlloc(allocator, &memReq, properties, 1, allocation)) {
+        vkDestroyBuffer(allocator->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return 1;
+    }
+    if(vkBindBufferMemory(allocator->device, *buffer, allocation->memory, allocation->offset) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO BIND BUFFER MEMORY\n");
+        allocatorFree(allocator, allocation);
+        allocation->memory = VK_NULL_HANDLE;
+        vkDestroyBuffer(allocator->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return 1;
+    }
+    return 0;
+}
+
+static inline void destroyBuffer(struct gpuAllocator* allocator, VkBuffer buffer, struct gpuAllocation* allocation){
+    vkDestroyBuffer(allocator->device, buffer, NULL);
+    allocatorFree(allocator, allocation);
+}
+
+// host coherent so writes through the mapping need no flush
+static inline int createLinearArena(struct gpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, struct linearArena* arena){
+    arena->capacity = size;
+    arena->head = 0;
+    arena->peak = 0;
+    return createBuffer(allocator, size, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &arena->buffer, &arena->allocation);
+}
+
+// offset is relative to arena->buffer, returns 1 without printing when the arena is full
+static inline int arenaAlloc(struct linearArena* arena, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset, void** data){
+    VkDeviceSize start = alignment > 1 ? (arena->head + alignment - 1) / alignment * alignment : arena->head;
+    if(start + size > arena->capacity) return 1;
+    arena->head = start + size;
+    *offset = start;
+    if(data) *data = (char*)arena->allocation.mapped + start;
+    return 0;
+}
+
+static inline void arenaReset(struct linearArena* arena){
+    if(arena->head > arena->peak) arena->peak = arena->head;
+    arena->head = 0;
+}
+
+// stand-ins for swapchain images when running without a surface
+static inline int createOffscreenImages(struct gpuAllocator* allocator, uint32_t imageCount, VkImage** images, struct gpuAllocation** memory, struct sChainImgInfo* imgInfo){
+    VkDevice device = allocator->device;
+    if((*images = realloc(*images, sizeof(VkImage)*imageCount)) == NULL || (*memory = realloc(*memory, sizeof(struct gpuAllocation)*imageCount)) == NULL){
+        fprintf(stdout,"ERROR: OFFSCREEN IMAGE REALLOC FAILED\n");
+        return 1;
+    }
+    imgInfo->swapChainExtent = (VkExtent2D){windowSize[0], windowSize[1]};
+    imgInfo->swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    imgInfo->swapChainImageCount = imageCount;
+    imgInfo->finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    for(uint32_t i = 0; i < imageCount; i++){
+        VkImageCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = imgInfo->swapChainImageFormat,
+            .extent = {imgInfo->swapChainExtent.width, imgInfo->swapChainExtent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        if(vkCreateImage(device, &createInfo, NULL, (*images) + i) != VK_SUCCESS){
+            fprintf(stdout, "ERROR: FAILED TO CREATE OFFSCREEN IMAGE #%d of %d\n", i, imageCount);
+            return 1;
+        }
+        VkMemoryRequirements memReq;
+        vkGetImageMemoryRequirements(device, (*images)[i], &memReq);
+        if(allocatorAlloc(allocator, &memReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, (*memory) + i) ||
+            vkBindImageMemory(device, (*images)[i], (*memory)[i].memory, (*memory)[i].offset) != VK_SUCCESS){
+            fprintf(stdout, "ERROR: FAILED TO ALLOCATE OFFSCREEN IMAGE MEMORY #%d of %d\n", i, imageCount);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline int createImageViews(VkDevice device, VkImageView** imageViews, VkImage** images, struct sChainImgInfo* imgInfo){ 
+    uint32_t imageCount = imgInfo->swapChainImageCount;
+    if((*imageViews = realloc(*imageViews, sizeof(VkImageView)*imageCount)) == NULL) {
+        fprintf(stdout, "ERROR: IMAGE VIEW REALLOC FAILED\n");
+        return 1;
+    }
+    for(int i = 0; i < imageCount; i++){
+        VkImageViewCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = (*images)[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = imgInfo->swapChainImageFormat,
+            .components = {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY
+            },
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
             }
         };
         if(vkCreateImageView(device,&createInfo, NULL, (*imageViews) + i) != VK_SUCCESS){
@@ -541,44 +2438,122 @@ static inline int createImageViews(VkDevice device, VkImageView** imageViews, Vk
     return 0;
 }
 
-static inline int readFile(const char* fileName, struct fileData* data){
-    FILE* fp = fopen(fileName, "r");
-    if(fp == NULL){
-        fprintf(stdout, "ERROR: FILE OPEN FAILED FOR %s\n",fileName);
+// device local, single mip and layer, for sampling once something has been copied into it
+static inline int createSampledImage(struct gpuAllocator* allocator, VkExtent3D extent, VkFormat format, VkImage* image, VkImageView* view, struct gpuAllocation* memory){
+    VkDevice device = allocator->device;
+    VkImageCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = extent,
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if(vkCreateImage(device, &createInfo, NULL, image) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO CREATE SAMPLED IMAGE\n");
+        return 1;
+    }
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(device, *image, &memReq);
+    if(allocatorAlloc(allocator, &memReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory) ||
+        vkBindImageMemory(device, *image, memory->memory, memory->offset) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO ALLOCATE SAMPLED IMAGE MEMORY\n");
         return 1;
     }
-    fseek(fp,0L, SEEK_END);
-    size_t res = ftell(fp);
-    if((data->code = (unsigned char*)malloc(sizeof(char)*res)) == NULL){
-        fprintf(stdout, "ERROR: MALLOC FAILED FOR %s\n",fileName);
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = *image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    if(vkCreateImageView(device, &viewInfo, NULL, view) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO CREATE SAMPLED IMAGE VIEW\n");
+        return 1;
+    }
+    return 0;
+}
+
+static inline void releaseShader(struct fileData* data){
+    if(data->mapSize) munmap((void*)data->code, data->mapSize);
+    data->code = NULL;
+    data->mapSize = 0;
+}
+
+// maps the file read-only instead of copying it, the mapping is page aligned so the words can be used in place
+static inline int mapFile(const char* fileName, struct fileData* data){
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0){
+        fprintf(stdout, "ERROR: FILE OPEN FAILED FOR %s\n",fileName);
         return 1;
     }
-    fseek(fp,0L,SEEK_SET);
-    if(fread(data->code,sizeof(char),res,fp) != res){
-        fprintf(stdout, "ERROR: FILE READ FAILED FOR %s\n",fileName);
-        if(data->code) free(data->code);
+    struct stat st;
+    if(fstat(fd, &st) || st.st_size <= 0){
+        fprintf(stdout, "ERROR: FILE STAT FAILED FOR %s\n",fileName);
+        close(fd);
         return 1;
     }
-    if(fclose(fp)){
-        fprintf(stdout, "ERROR: FAILURE TO CLOSE FILE %s\n",fileName);
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if(map == MAP_FAILED){
+        fprintf(stdout, "ERROR: FILE MAP FAILED FOR %s\n",fileName);
         return 1;
     }
-    data->codeSize = res;
+    data->code = map;
+    data->codeSize = st.st_size;
+    data->mapSize = st.st_size;
     return 0;
+}
+
+static inline int loadShader(const char* fileName, struct fileData* data){
+    data->mapSize = 0;
+#ifdef EMBED_SHADERS
+    for(size_t i = 0; i < sizeof(embeddedShaders) / sizeof(embeddedShaders[0]); i++){
+        if(strcmp(embeddedShaders[i].fileName, fileName)) continue;
+        data->code = embeddedShaders[i].code;
+        data->codeSize = embeddedShaders[i].end - (const unsigned char*)embeddedShaders[i].code;
+        return 0;
+    }
+#endif
+    return mapFile(fileName, data);
+}
 
+static inline int validateSpirv(const char* fileName, struct fileData* data){
+    // the 5 word header is the smallest valid module
+    if(data->codeSize < 5 * sizeof(uint32_t) || data->codeSize % sizeof(uint32_t) || (uintptr_t)data->code % sizeof(uint32_t)){
+        fprintf(stdout, "ERROR: %s IS NOT A WORD ALIGNED SPIR-V MODULE\n", fileName);
+        return 1;
+    }
+    if(data->code[0] != SPIRV_MAGIC){
+        fprintf(stdout, "ERROR: %s HAS NO SPIR-V MAGIC NUMBER\n", fileName);
+        return 1;
+    }
+    return 0;
 }
 
-static inline int createShaderModule(VkDevice device ,struct fileData* shaderCode, VkShaderModule* shader){
+static inline int createShaderModule(VkDevice device, const char* fileName, VkShaderModule* shader){
+    struct fileData shaderCode;
+    if(loadShader(fileName, &shaderCode)) return 1;
+    if(validateSpirv(fileName, &shaderCode)){
+        releaseShader(&shaderCode);
+        return 1;
+    }
     VkShaderModuleCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shaderCode->codeSize,
-        .pCode = (const uint32_t*)shaderCode->code
+        .codeSize = shaderCode.codeSize,
+        .pCode = shaderCode.code
     };
-    if(vkCreateShaderModule(device,&createInfo, NULL, shader)) {
-        fprintf(stdout, "ERROR: SHADER MODULE CREATION FAILED\n");
+    VkResult res = vkCreateShaderModule(device,&createInfo, NULL, shader);
+    releaseShader(&shaderCode); // the driver keeps its own copy
+    if(res != VK_SUCCESS) {
+        fprintf(stdout, "ERROR: SHADER MODULE CREATION FAILED FOR %s\n", fileName);
         return 1;
     }
-    free(shaderCode->code);
     return 0;
 }
 
@@ -591,7 +2566,7 @@ static inline int createRenderPass(VkDevice device, struct sChainImgInfo* imgInf
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        .finalLayout = imgInfo->finalLayout
     };
 
     VkAttachmentReference colorAttachmentRef = {
@@ -632,90 +2607,265 @@ static inline int createRenderPass(VkDevice device, struct sChainImgInfo* imgInf
     return 0;
 }
 
-static inline int createGraphicsPipeline(VkDevice device, struct sChainImgInfo* imgInfo, VkRenderPass* renderPass, VkPipelineLayout* layout, VkPipeline* pipeline ){
-    struct fileData vertShaderCode;
-    struct fileData fragShaderCode;
-    if(readFile("shaders/vert.spv",&vertShaderCode)) return 1;
-    if(readFile("shaders/frag.spv",&fragShaderCode)) return 1;
+// the cache blob starts with a VkPipelineCacheHeaderVersionOne, data from another driver or gpu is dropped
+static inline int pipelineCacheHeaderValid(const unsigned char* data, size_t size, VkPhysicalDeviceProperties* props){
+    VkPipelineCacheHeaderVersionOne header;
+    if(size < sizeof(header)) return 0;
+    memcpy(&header, data, sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerSize <= size &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == props->vendorID &&
+        header.deviceID == props->deviceID &&
+        memcmp(header.pipelineCacheUUID, props->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static inline int createPipelineCache(VkDevice device, VkPhysicalDeviceProperties* props, const char* path, VkPipelineCache* cache, uint32_t* loaded){
+    unsigned char* data = NULL;
+    size_t size = 0;
+    *loaded = 0;
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL){ // a missing file just means a cold start
+        long fileSize;
+        if(fseek(fp, 0L, SEEK_END) == 0 && (fileSize = ftell(fp)) > 0 && fseek(fp, 0L, SEEK_SET) == 0 && (data = malloc(fileSize)) != NULL){
+            size = fread(data, 1, fileSize, fp) == (size_t)fileSize ? (size_t)fileSize : 0;
+        }
+        fclose(fp);
+        if(!pipelineCacheHeaderValid(data, size, props)){
+            fprintf(stdout, "WARNING: IGNORING STALE OR INVALID PIPELINE CACHE %s\n", path);
+            size = 0;
+        }
+    }
+    VkPipelineCacheCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = size ? data : NULL
+    };
+    VkResult res = vkCreatePipelineCache(device, &createInfo, NULL, cache);
+    free(data);
+    if(res != VK_SUCCESS){
+        fprintf(stdout, "ERROR: PIPELINE CACHE CREATION FAILED\n");
+        return 1;
+    }
+    *loaded = (size != 0);
+    return 0;
+}
+
+// written to a temporary file first so a crash never leaves a truncated cache behind
+static inline int savePipelineCache(VkDevice device, VkPipelineCache cache, const char* path){
+    size_t size = 0;
+    if(vkGetPipelineCacheData(device, cache, &size, NULL) != VK_SUCCESS || !size) return 1;
+    unsigned char* data = malloc(size);
+    if(data == NULL){
+        fprintf(stdout, "ERROR: MALLOC FAILED FOR PIPELINE CACHE\n");
+        return 1;
+    }
+    if(vkGetPipelineCacheData(device, cache, &size, data) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO GET PIPELINE CACHE DATA\n");
+        free(data);
+        return 1;
+    }
+    char tmpPath[strlen(path) + 5];
+    sprintf(tmpPath, "%s.tmp", path);
+    FILE* fp = fopen(tmpPath, "wb");
+    if(fp == NULL){
+        fprintf(stdout, "ERROR: FILE OPEN FAILED FOR %s\n", tmpPath);
+        free(data);
+        return 1;
+    }
+    int failed = fwrite(data, 1, size, fp) != size;
+    failed |= fclose(fp) != 0;
+    free(data);
+    if(failed || rename(tmpPath, path)){
+        fprintf(stdout, "ERROR: FAILED TO WRITE PIPELINE CACHE %s\n", path);
+        remove(tmpPath);
+        return 1;
+    }
+    return 0;
+}
+
+// shared by every pipeline drawing the scene, push constants only with DRAW_DATA_PUSH
+static inline int createPipelineLayout(VkDevice device, uint32_t drawData, const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, VkPipelineLayout* layout){
+    VkPushConstantRange pushRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(struct drawConstants)
+    };
+    VkPipelineLayoutCreateInfo layoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = setLayoutCount,
+        .pSetLayouts = setLayouts,
+        .pushConstantRangeCount = drawData == DRAW_DATA_PUSH,
+        .pPushConstantRanges = drawData == DRAW_DATA_PUSH ? &pushRange : NULL
+    };
+
+    if(vkCreatePipelineLayout(device, &layoutCreateInfo, NULL, layout ) != VK_SUCCESS ) {
+        fprintf(stdout, "ERROR: PIPELINE LAYOUT CREATION FAILED\n");
+        return 1;
+    }
+    return 0;
+}
+
+// the scene's pipeline, variants start from it and change single fields
+static inline void pipelineDescDefault(uint32_t vertexLayout, uint32_t drawData, VkPipelineLayout layout, VkRenderPass renderPass, VkFormat colorFormat, struct pipelineDesc* desc){
+    memset(desc, 0, sizeof(*desc)); // padding and the unused end of the file names are hashed too
+    const char* vertFile = drawData == DRAW_DATA_PUSH ? "shaders/draw.spv" : drawData == DRAW_DATA_UNIFORM ? "shaders/draw_uniform.spv" : "shaders/vert.spv";
+    strncpy(desc->vertexShader, vertFile, PIPELINE_SHADER_NAME_SIZE - 1);
+    strncpy(desc->fragmentShader, "shaders/frag.spv", PIPELINE_SHADER_NAME_SIZE - 1);
+    desc->vertexLayout = vertexLayout;
+    desc->drawData = drawData;
+    desc->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc->cullMode = VK_CULL_MODE_BACK_BIT;
+    desc->frontFace = VK_FRONT_FACE_CLOCKWISE;
+    desc->blendEnable = VK_FALSE;
+    desc->colorFormat = colorFormat;
+    desc->renderPass = renderPass;
+    desc->layout = layout;
+    desc->specialization[SPEC_COLOR_MODE] = COLOR_MODE_SHADED;
+    desc->specialization[SPEC_TINT] = VK_TRUE;
+}
+
+// loaded on first use, a module two threads raced to create is kept once
+static inline int pipelineShaderModule(struct pipelineRegistry* registry, const char* fileName, VkShaderModule* module){
+    pthread_mutex_lock(&registry->mutex);
+    for(uint32_t i = 0; i < registry->moduleCount; i++){
+        if(strcmp(registry->modules[i].name, fileName) == 0){
+            *module = registry->modules[i].module;
+            pthread_mutex_unlock(&registry->mutex);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&registry->mutex);
+    VkShaderModule created;
+    if(createShaderModule(registry->device, fileName, &created)) return 1;
+    pthread_mutex_lock(&registry->mutex);
+    for(uint32_t i = 0; i < registry->moduleCount; i++){
+        if(strcmp(registry->modules[i].name, fileName) == 0){
+            *module = registry->modules[i].module;
+            pthread_mutex_unlock(&registry->mutex);
+            vkDestroyShaderModule(registry->device, created, NULL);
+            return 0;
+        }
+    }
+    if(registry->moduleCount == PIPELINE_MAX_MODULES){
+        pthread_mutex_unlock(&registry->mutex);
+        vkDestroyShaderModule(registry->device, created, NULL);
+        fprintf(stdout, "ERROR: PIPELINE REGISTRY HOLDS AT MOST %d SHADER MODULES\n", PIPELINE_MAX_MODULES);
+        return 1;
+    }
+    struct pipelineModule* entry = registry->modules + registry->moduleCount++;
+    strncpy(entry->name, fileName, PIPELINE_SHADER_NAME_SIZE - 1);
+    entry->name[PIPELINE_SHADER_NAME_SIZE - 1] = '\0';
+    entry->module = created;
+    *module = created;
+    pthread_mutex_unlock(&registry->mutex);
+    return 0;
+}
+
+// fills build->info from desc, the create info points into build so build must not move until the pipeline exists
+static inline int pipelineBuildInit(struct pipelineRegistry* registry, const struct pipelineDesc* desc, struct pipelineBuild* build){
+    // the per-instance stream always follows the mesh streams
+    static const VkVertexInputBindingDescription interleavedBindings[] = {
+        {.binding = 0, .stride = sizeof(struct vertex), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+        {.binding = 1, .stride = sizeof(struct instanceData), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}
+    };
+    static const VkVertexInputAttributeDescription interleavedAttributes[] = {
+        {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(struct vertex, pos)},
+        {.location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(struct vertex, color)},
+        {.location = 2, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(struct instanceData, transform)},
+        {.location = 3, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(struct instanceData, color)}
+    };
+    static const VkVertexInputBindingDescription splitBindings[] = {
+        {.binding = 0, .stride = sizeof(((struct vertex*)0)->pos), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+        {.binding = 1, .stride = sizeof(((struct vertex*)0)->color), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+        {.binding = 2, .stride = sizeof(struct instanceData), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}
+    };
+    static const VkVertexInputAttributeDescription splitAttributes[] = {
+        {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = 0},
+        {.location = 1, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = 0},
+        {.location = 2, .binding = 2, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(struct instanceData, transform)},
+        {.location = 3, .binding = 2, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(struct instanceData, color)}
+    };
+    static const VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
     VkShaderModule vertShaderModule;
     VkShaderModule fragShaderModule;
-    if(createShaderModule(device,&vertShaderCode,&vertShaderModule)) return 1;
-    if(createShaderModule(device,&fragShaderCode,&fragShaderModule)) return 1;
+    if(pipelineShaderModule(registry, desc->vertexShader, &vertShaderModule)) return 1;
+    if(pipelineShaderModule(registry, desc->fragmentShader, &fragShaderModule)) return 1;
+
+    // the values are read from the stored description, ids a stage does not declare are ignored by it
+    for(uint32_t i = 0; i < PIPELINE_SPEC_CONSTANTS; i++){
+        build->specEntries[i] = (VkSpecializationMapEntry){.constantID = i, .offset = sizeof(uint32_t) * i, .size = sizeof(uint32_t)};
+    }
+    build->specInfo = (VkSpecializationInfo){
+        .mapEntryCount = PIPELINE_SPEC_CONSTANTS,
+        .pMapEntries = build->specEntries,
+        .dataSize = sizeof(desc->specialization),
+        .pData = desc->specialization
+    };
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {{
+    build->shaderStages[0] = (VkPipelineShaderStageCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_VERTEX_BIT,
         .module = vertShaderModule,
         .pName = "main",
-        .pSpecializationInfo = NULL
-    },{
+        .pSpecializationInfo = &build->specInfo
+    };
+    build->shaderStages[1] = (VkPipelineShaderStageCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
         .module = fragShaderModule,
         .pName = "main",
-        .pSpecializationInfo = NULL
-    }};
-
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
+        .pSpecializationInfo = &build->specInfo
     };
-    uint32_t dynamicStateCount = 2;
-    VkPipelineDynamicStateCreateInfo dynamicStateCreate = {
+
+    build->dynamicStateCreate = (VkPipelineDynamicStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount = dynamicStateCount,
+        .dynamicStateCount = 2,
         .pDynamicStates = dynamicStates
     };
 
-    VkPipelineVertexInputStateCreateInfo vertexCreateInfo = {
+    uint32_t split = desc->vertexLayout == VERTEX_LAYOUT_SPLIT;
+    // per-draw data replaces the instance stream, which is always last
+    uint32_t instanced = desc->drawData == DRAW_DATA_INSTANCED;
+    build->vertexCreateInfo = (VkPipelineVertexInputStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 0,
-        .pVertexBindingDescriptions = NULL,
-        .vertexAttributeDescriptionCount = 0,
-        .pVertexAttributeDescriptions = NULL
+        .vertexBindingDescriptionCount = (split ? 2 : 1) + instanced,
+        .pVertexBindingDescriptions = split ? splitBindings : interleavedBindings,
+        .vertexAttributeDescriptionCount = instanced ? 4 : 2,
+        .pVertexAttributeDescriptions = split ? splitAttributes : interleavedAttributes
     };
 
-    VkPipelineInputAssemblyStateCreateInfo inputCreateInfo = {
+    build->inputCreateInfo = (VkPipelineInputAssemblyStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .topology = desc->topology,
         .primitiveRestartEnable = VK_FALSE,
     };
 
-    VkViewport viewPort = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = imgInfo->swapChainExtent.width,
-        .height = imgInfo->swapChainExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-
-    VkRect2D scissor = {
-        .offset = {0, 0},
-        .extent = imgInfo->swapChainExtent
-    };
-
-    VkPipelineViewportStateCreateInfo viewPortCreateInfo = {
+    // viewport and scissor are dynamic
+    build->viewPortCreateInfo = (VkPipelineViewportStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .viewportCount = 1,
         .scissorCount = 1
     };
 
-    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {
+    build->rasterizerCreateInfo = (VkPipelineRasterizationStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
         .depthClampEnable = VK_FALSE,
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = VK_POLYGON_MODE_FILL,
         .lineWidth = 1.0f,
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .cullMode = desc->cullMode,
+        .frontFace = desc->frontFace,
         .depthBiasEnable = VK_FALSE,
         .depthBiasConstantFactor = 0.0f,
         .depthBiasSlopeFactor = 0.0f,
         .depthBiasClamp = 0.0f
     };
 
-    VkPipelineMultisampleStateCreateInfo multiCreateInfo = {
+    build->multiCreateInfo = (VkPipelineMultisampleStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
         .sampleShadingEnable = VK_FALSE,
         .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
@@ -725,68 +2875,202 @@ static inline int createGraphicsPipeline(VkDevice device, struct sChainImgInfo*
         .alphaToOneEnable = VK_FALSE
     };
 
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+    build->colorBlendAttachment = (VkPipelineColorBlendAttachmentState){
         .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        .blendEnable = VK_FALSE,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .blendEnable = desc->blendEnable,
+        .srcColorBlendFactor = desc->blendEnable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = desc->blendEnable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
         .colorBlendOp = VK_BLEND_OP_ADD,
         .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
         .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
         .alphaBlendOp = VK_BLEND_OP_ADD
     };
 
-    VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {
+    build->colorBlendCreateInfo = (VkPipelineColorBlendStateCreateInfo){
         .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
         .logicOpEnable = VK_FALSE,
         .logicOp = VK_LOGIC_OP_COPY,
         .attachmentCount = 1,
-        .pAttachments = &colorBlendAttachment,
+        .pAttachments = &build->colorBlendAttachment,
         .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
     };
 
-    VkPipelineLayoutCreateInfo layoutCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 0,
-        .pSetLayouts = NULL,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL
+    // without a render pass the pipeline only needs to know the attachment formats
+    build->renderingCreateInfo = (VkPipelineRenderingCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &desc->colorFormat,
+        .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
     };
-
-    if(vkCreatePipelineLayout(device, &layoutCreateInfo, NULL, layout ) != VK_SUCCESS ) {
-        fprintf(stdout, "ERROR: PIPELINE LAYOUT CREATION FAILED\n");
-        return 1;
-    }
-
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
+    build->info = (VkGraphicsPipelineCreateInfo){
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = desc->renderPass == VK_NULL_HANDLE ? &build->renderingCreateInfo : NULL,
         .stageCount = 2,
-        .pStages = shaderStages,
-        .pVertexInputState = &vertexCreateInfo,
-        .pInputAssemblyState = &inputCreateInfo,
-        .pViewportState = &viewPortCreateInfo,
-        .pRasterizationState = &rasterizerCreateInfo,
-        .pMultisampleState = &multiCreateInfo,
+        .pStages = build->shaderStages,
+        .pVertexInputState = &build->vertexCreateInfo,
+        .pInputAssemblyState = &build->inputCreateInfo,
+        .pViewportState = &build->viewPortCreateInfo,
+        .pRasterizationState = &build->rasterizerCreateInfo,
+        .pMultisampleState = &build->multiCreateInfo,
         .pDepthStencilState = NULL,
-        .pColorBlendState = &colorBlendCreateInfo,
-        .pDynamicState = &dynamicStateCreate,
-        .layout = *layout,
-        .renderPass = *renderPass,
+        .pColorBlendState = &build->colorBlendCreateInfo,
+        .pDynamicState = &build->dynamicStateCreate,
+        .layout = desc->layout,
+        .renderPass = desc->renderPass,
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1
     };
+    return 0;
+}
 
-    if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, NULL, pipeline ) != VK_SUCCESS ){
-        fprintf(stdout, "ERROR: GRAPHICS PIPELINE CREATION FAILED\n");
-        return 1;
+// FNV-1a over the whole description
+static inline uint64_t pipelineDescHash(const struct pipelineDesc* desc){
+    const unsigned char* bytes = (const unsigned char*)desc;
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < sizeof(*desc); i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// builds entries [first, first + count) with one vkCreateGraphicsPipelines, called without the registry lock
+// the descriptions never change once stored so they are read unlocked, results are published under the lock
+static inline void pipelineCompileBatch(struct pipelineRegistry* registry, uint32_t first, uint32_t count){
+    struct pipelineBuild builds[PIPELINE_BATCH_SIZE];
+    VkGraphicsPipelineCreateInfo infos[PIPELINE_BATCH_SIZE];
+    VkPipeline pipelines[PIPELINE_BATCH_SIZE];
+    uint32_t built[PIPELINE_BATCH_SIZE];
+    uint32_t infoCount = 0;
+    double start = timeMs();
+    for(uint32_t i = 0; i < count; i++){
+        built[i] = !pipelineBuildInit(registry, &registry->entries[first + i].desc, builds + infoCount);
+        if(!built[i]) continue;
+        infos[infoCount] = builds[infoCount].info;
+        infoCount++;
+    }
+    // on failure the pipelines that could not be created are VK_NULL_HANDLE
+    for(uint32_t i = 0; i < infoCount; i++) pipelines[i] = VK_NULL_HANDLE;
+    VkResult res = infoCount ? vkCreateGraphicsPipelines(registry->device, registry->cache, infoCount, infos, NULL, pipelines) : VK_SUCCESS;
+    double elapsed = timeMs() - start;
+
+    pthread_mutex_lock(&registry->mutex);
+    for(uint32_t i = 0, p = 0; i < count; i++){
+        struct pipelineEntry* entry = registry->entries + first + i;
+        entry->pipeline = built[i] ? pipelines[p++] : VK_NULL_HANDLE;
+        entry->state = entry->pipeline != VK_NULL_HANDLE ? PIPELINE_READY : PIPELINE_FAILED;
+        entry->readyMs = timeMs();
+        if(entry->state == PIPELINE_FAILED){
+            // only entries that were submitted have a result, the others stopped at loading or checking their modules
+            if(built[i]) fprintf(stdout, "ERROR: GRAPHICS PIPELINE CREATION FAILED FOR %s (%d)\n", entry->desc.vertexShader, res);
+            else fprintf(stdout, "ERROR: GRAPHICS PIPELINE SETUP FAILED FOR %s\n", entry->desc.vertexShader);
+            registry->failed++;
+        } else registry->compiled++;
+    }
+    registry->batches++;
+    registry->compileMs += elapsed;
+    if(elapsed > registry->maxBatchMs) registry->maxBatchMs = elapsed;
+    pthread_mutex_unlock(&registry->mutex);
+}
+
+// takes whatever is queued, up to a batch, in request order
+static void* pipelineWorkerMain(void* arg){
+    struct pipelineRegistry* registry = arg;
+    for(;;){
+        pthread_mutex_lock(&registry->mutex);
+        while(registry->claimed == registry->count && !registry->quit) pthread_cond_wait(&registry->wake, &registry->mutex);
+        if(registry->quit){
+            pthread_mutex_unlock(&registry->mutex);
+            return NULL;
+        }
+        uint32_t first = registry->claimed;
+        uint32_t count = registry->count - first < PIPELINE_BATCH_SIZE ? registry->count - first : PIPELINE_BATCH_SIZE;
+        registry->claimed += count;
+        pthread_mutex_unlock(&registry->mutex);
+
+        pipelineCompileBatch(registry, first, count);
     }
+}
 
-    vkDestroyShaderModule(device, vertShaderModule, NULL);
-    vkDestroyShaderModule(device, fragShaderModule, NULL);
+// threadCount 0 compiles every pipeline on the thread asking for it, before the request returns
+static inline int createPipelineRegistry(VkDevice device, VkPipelineCache cache, uint32_t threadCount, struct pipelineRegistry* registry){
+    memset(registry, 0, sizeof(*registry));
+    registry->device = device;
+    registry->cache = cache;
+    pthread_mutex_init(&registry->mutex, NULL);
+    pthread_cond_init(&registry->wake, NULL);
+    for(uint32_t t = 0; t < threadCount; t++){
+        if(pthread_create(registry->threads + t, NULL, pipelineWorkerMain, registry)){
+            fprintf(stdout, "ERROR: FAILED TO START PIPELINE THREAD %u\n", t);
+            return 1;
+        }
+        registry->threadCount++; // only join what was started
+    }
     return 0;
 }
 
+// identical descriptions share one entry, handle stays valid for the registry's lifetime
+static inline int pipelineRequest(struct pipelineRegistry* registry, const struct pipelineDesc* desc, uint32_t* handle){
+    uint64_t hash = pipelineDescHash(desc);
+    pthread_mutex_lock(&registry->mutex);
+    registry->requests++;
+    for(uint32_t i = 0; i < registry->count; i++){
+        if(registry->entries[i].hash == hash && memcmp(&registry->entries[i].desc, desc, sizeof(*desc)) == 0){
+            registry->hits++;
+            *handle = i;
+            pthread_mutex_unlock(&registry->mutex);
+            return 0;
+        }
+    }
+    if(registry->count == PIPELINE_REGISTRY_SIZE){
+        pthread_mutex_unlock(&registry->mutex);
+        fprintf(stdout, "ERROR: PIPELINE REGISTRY HOLDS AT MOST %d PIPELINES\n", PIPELINE_REGISTRY_SIZE);
+        return 1;
+    }
+    struct pipelineEntry* entry = registry->entries + registry->count;
+    memcpy(&entry->desc, desc, sizeof(*desc));
+    entry->hash = hash;
+    entry->state = PIPELINE_PENDING;
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->requestMs = timeMs();
+    *handle = registry->count++;
+    if(registry->threadCount){
+        pthread_cond_signal(&registry->wake);
+        pthread_mutex_unlock(&registry->mutex);
+        return 0;
+    }
+    registry->claimed = registry->count;
+    pthread_mutex_unlock(&registry->mutex);
+    pipelineCompileBatch(registry, *handle, 1);
+    return entry->state == PIPELINE_FAILED;
+}
+
+// never blocks, VK_NULL_HANDLE until the pipeline is compiled and callers skip what would have drawn with it, 1 once it failed
+static inline int pipelineGet(struct pipelineRegistry* registry, uint32_t handle, VkPipeline* pipeline){
+    pthread_mutex_lock(&registry->mutex);
+    *pipeline = registry->entries[handle].pipeline;
+    uint32_t failed = registry->entries[handle].state == PIPELINE_FAILED;
+    pthread_mutex_unlock(&registry->mutex);
+    return failed;
+}
+
+// lets the threads finish what they hold, pipelines still queued are dropped
+static inline void destroyPipelineRegistry(struct pipelineRegistry* registry){
+    pthread_mutex_lock(&registry->mutex);
+    registry->quit = 1;
+    pthread_cond_broadcast(&registry->wake);
+    pthread_mutex_unlock(&registry->mutex);
+    for(uint32_t t = 0; t < registry->threadCount; t++) pthread_join(registry->threads[t], NULL);
+    for(uint32_t i = 0; i < registry->count; i++){
+        if(registry->entries[i].pipeline != VK_NULL_HANDLE) vkDestroyPipeline(registry->device, registry->entries[i].pipeline, NULL);
+    }
+    for(uint32_t i = 0; i < registry->moduleCount; i++) vkDestroyShaderModule(registry->device, registry->modules[i].module, NULL);
+    pthread_mutex_destroy(&registry->mutex);
+    pthread_cond_destroy(&registry->wake);
+}
+
 static inline int createFrameBuffers(VkDevice device , struct sChainImgInfo* imgInfo, VkImageView** imageViews, VkRenderPass* renderPass, VkFramebuffer* frameBuffers){
     uint32_t imgCount = imgInfo->swapChainImageCount;
     for (uint32_t i = 0; i < imgCount; i++)
@@ -809,16 +3093,21 @@ static inline int createFrameBuffers(VkDevice device , struct sChainImgInfo* img
     return 0;
 }
 
-static inline int createCommandPool(VkDevice device,VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface , VkCommandPool* commandPool){
+static inline int createCommandPool(VkDevice device,VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface , VkCommandPoolCreateFlags flags, VkCommandPool* commandPool){
     struct QueueFamilyIndices indices;
     if(findQueueFamilies(physicalDevice, &indices,  surface) ) {
         fprintf(stdout, "ERROR: FAILED TO FIND QUEUE FAMILIES DURING COMMAND POOL CREATION\n");
         return 1;
     }
+    return createFamilyCommandPool(device, indices.graphicsFamily, flags, commandPool);
+}
+
+// buffers from the pool can only be submitted to queues of that family
+static inline int createFamilyCommandPool(VkDevice device, uint32_t family, VkCommandPoolCreateFlags flags, VkCommandPool* commandPool){
     VkCommandPoolCreateInfo poolCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = indices.graphicsFamily
+        .flags = flags,
+        .queueFamilyIndex = family
     };
     if(vkCreateCommandPool(device, &poolCreateInfo, NULL, commandPool) != VK_SUCCESS ) {
         fprintf(stdout, "ERROR: COMMAND POOL CREATION FAILED\n");
@@ -842,81 +3131,2701 @@ static inline int createCommandBuffer( VkDevice device , VkCommandPool pool , Vk
     return 0;
 }
 
-static inline int recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkFramebuffer* frameBuffers, VkRenderPass renderPass, struct sChainImgInfo* imgInfo, VkPipeline graphicsPipeline){
-    VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = 0,
-        .pInheritanceInfo = NULL
-    };
-
-    if(vkBeginCommandBuffer(commandBuffer, &beginInfo ) != VK_SUCCESS ){
-        fprintf(stdout, "ERROR: FAILED TO BEGIN RECORDING COMMAND BUFFER\n");
+// instances are laid out on a square grid, a single instance is the identity transform
+static inline int createInstanceRing(struct gpuAllocator* allocator, struct qHandles* queues, uint32_t instanceCount, uint32_t frameCount, uint32_t drawData, struct instanceRing* ring){
+    ring->instanceCount = instanceCount;
+    ring->host = NULL;
+    // per-draw data is read back while recording, which is slow from write-combined memory, so the frame is built in host memory
+    if(drawData != DRAW_DATA_INSTANCED && (ring->host = malloc(sizeof(struct instanceData) * instanceCount)) == NULL){
+        fprintf(stdout, "ERROR: INSTANCE MALLOC FAILED\n");
         return 1;
     }
+    // slices are also bound as storage buffers by the culling pass
+    ring->sliceSize = (sizeof(struct instanceData) * (VkDeviceSize)instanceCount + STORAGE_OFFSET_ALIGNMENT - 1) & ~(VkDeviceSize)(STORAGE_OFFSET_ALIGNMENT - 1);
+    if((ring->base = malloc(sizeof(struct instanceData) * instanceCount)) == NULL){
+        fprintf(stdout, "ERROR: INSTANCE MALLOC FAILED\n");
+        return 1;
+    }
+    uint32_t side = 1;
+    while(side * side < instanceCount) side++;
+    float cell = 2.0f / side;
+    for(uint32_t i = 0; i < instanceCount; i++){
+        uint32_t x = i % side, y = i / side;
+        float u = (float)x / side, v = (float)y / side;
+        ring->base[i] = (struct instanceData){
+            {-1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f), cell * 0.5f},
+            {1.0f, 1.0f - 0.5f * u, 1.0f - 0.5f * v}
+        };
+    }
+    for(uint32_t i = 0; i < INSTANCE_WOBBLE_STEPS; i++) ring->wobble[i] = 0.1f * cell * sinf(6.2831853f * i / INSTANCE_WOBBLE_STEPS);
+    // written by the host and read by both the culling pass and the vertex stage
+    uint32_t families[2] = {queues->graphicsFamily, queues->computeFamily};
+    if(createSharedBuffer(allocator, ring->sliceSize * frameCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, families, 2, &ring->buffer, &ring->allocation)){
+        free(ring->base);
+        return 1;
+    }
+    return 0;
+}
+
+// rewrites the whole slice every frame, this is the per-instance cpu cost the instance sweep measures
+// a cullRadius above 0 drops instances whose bounding circle is outside the clip rect and compacts the rest
+static inline void updateInstances(struct instanceRing* ring, uint32_t frameSlot, uint64_t frameNumber, float panX, float cullRadius){
+    struct instanceData* dst = ring->host ? ring->host : (struct instanceData*)((char*)ring->allocation.mapped + ring->sliceSize * frameSlot);
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < ring->instanceCount; i++){
+        struct instanceData instance = ring->base[i];
+        instance.transform[0] += panX;
+        if(ring->instanceCount > 1) instance.transform[1] += ring->wobble[(i + frameNumber) % INSTANCE_WOBBLE_STEPS];
+        float r = instance.transform[2] * cullRadius;
+        if(cullRadius > 0.0f && (instance.transform[0] + r < -1.0f || instance.transform[0] - r > 1.0f ||
+            instance.transform[1] + r < -1.0f || instance.transform[1] - r > 1.0f)) continue;
+        dst[count++] = instance;
+    }
+    ring->drawCount[frameSlot] = count;
+}
+
+static inline float meshBoundingRadius(struct meshData* data){
+    float radius = 0.0f;
+    for(uint32_t i = 0; i < data->vertexCount; i++){
+        float* pos = data->vertices[i].pos;
+        float r = sqrtf(pos[0] * pos[0] + pos[1] * pos[1]);
+        if(r > radius) radius = r;
+    }
+    return radius;
+}
+
+static inline int createCuller(struct gpuAllocator* allocator, struct qHandles* queues, VkPhysicalDeviceProperties* props, struct descriptorCache* descriptors, VkPipelineCache cache, struct instanceRing* instances, uint32_t frameCount, uint32_t indexCount, float meshRadius, struct gpuCuller* culler){
+    culler->graphicsFamily = queues->graphicsFamily;
+    culler->computeFamily = queues->computeFamily;
+    culler->push = (struct cullPush){{-1.0f, -1.0f, 1.0f, 1.0f}, instances->instanceCount, indexCount, meshRadius};
+    culler->maxDrawCount = props->limits.maxDrawIndirectCount;
+    VkDeviceSize drawSize = sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)instances->instanceCount;
+    culler->drawSlice = (drawSize + STORAGE_OFFSET_ALIGNMENT - 1) & ~(VkDeviceSize)(STORAGE_OFFSET_ALIGNMENT - 1);
+    if(createBuffer(allocator, culler->drawSlice * frameCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culler->drawBuffer, &culler->drawMemory)) return 1;
+    if(createBuffer(allocator, STORAGE_OFFSET_ALIGNMENT * frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &culler->countBuffer, &culler->countMemory)) return 1;
+    memset(culler->countMemory.mapped, 0, STORAGE_OFFSET_ALIGNMENT * frameCount);
+
+    VkDescriptorType types[3] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+    if(createComputeKernel(descriptors, cache, "shaders/cull.spv", types, 3, sizeof(struct cullPush), frameCount, &culler->kernel)) return 1;
+    for(uint32_t i = 0; i < frameCount; i++){
+        struct computeBinding bindings[3] = {
+            {instances->buffer, instances->sliceSize * i, sizeof(struct instanceData) * (VkDeviceSize)instances->instanceCount, VK_NULL_HANDLE},
+            {culler->drawBuffer, culler->drawSlice * i, drawSize, VK_NULL_HANDLE},
+            {culler->countBuffer, STORAGE_OFFSET_ALIGNMENT * i, sizeof(uint32_t), VK_NULL_HANDLE}
+        };
+        if(computeKernelSet(&culler->kernel, bindings, culler->sets + i)) return 1;
+    }
+    return 0;
+}
+
+// runs before the render pass, the draws it writes are consumed by vkCmdDrawIndexedIndirect in the same command buffer
+static inline void recordCulling(VkCommandBuffer commandBuffer, struct gpuCuller* culler, uint32_t frameSlot){
+    vkCmdFillBuffer(commandBuffer, culler->countBuffer, STORAGE_OFFSET_ALIGNMENT * frameSlot, sizeof(uint32_t), 0);
+    VkMemoryBarrier cleared = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &cleared, 0, NULL, 0, NULL);
+    recordDispatch(commandBuffer, &culler->kernel, culler->sets[frameSlot], &culler->push, (culler->push.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    if(culler->computeFamily == culler->graphicsFamily){
+        VkMemoryBarrier written = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &written, 0, NULL, 0, NULL);
+        return;
+    }
+    // the count is only read by the host, the commands are released to the graphics family which acquires them before drawing
+    VkMemoryBarrier counted = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    };
+    VkBufferMemoryBarrier release = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .srcQueueFamilyIndex = culler->computeFamily,
+        .dstQueueFamilyIndex = culler->graphicsFamily,
+        .buffer = culler->drawBuffer,
+        .offset = culler->drawSlice * frameSlot,
+        .size = culler->drawSlice
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 1, &counted, 1, &release, 0, NULL);
+}
+
+// graphics half of the ownership transfer, the previous contents of the slice are never carried back so compute takes it without one
+static inline void recordCullingAcquire(VkCommandBuffer commandBuffer, struct gpuCuller* culler, uint32_t frameSlot){
+    VkBufferMemoryBarrier acquire = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        .srcQueueFamilyIndex = culler->computeFamily,
+        .dstQueueFamilyIndex = culler->graphicsFamily,
+        .buffer = culler->drawBuffer,
+        .offset = culler->drawSlice * frameSlot,
+        .size = culler->drawSlice
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, NULL, 1, &acquire, 0, NULL);
+}
+
+// records and submits the frame's culling on the compute queue, the graphics submit waits for value on the compute timeline
+static inline int submitCulling(VkDevice device, struct syncLayer* sync, struct frameData* frame, struct gpuCuller* culler, uint32_t frameSlot, uint64_t* value){
+    VkCommandBuffer commandBuffer;
+    if(commandAllocatorGet(device, &frame->computeCommands, &commandBuffer)) return 1;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO BEGIN RECORDING COMPUTE COMMAND BUFFER\n");
+        return 1;
+    }
+    recordCulling(commandBuffer, culler, frameSlot);
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO RECORD COMPUTE COMMAND BUFFER\n");
+        return 1;
+    }
+    return syncSubmit(sync, SYNC_COMPUTE, NULL, &commandBuffer, 1, VK_NULL_HANDLE, value);
+}
+
+// only meaningful once the slot's timeline value is reached
+static inline uint32_t cullerVisibleCount(struct gpuCuller* culler, uint32_t frameSlot){
+    return *(uint32_t*)((char*)culler->countMemory.mapped + STORAGE_OFFSET_ALIGNMENT * frameSlot);
+}
+
+static inline void destroyCuller(struct gpuAllocator* allocator, struct gpuCuller* culler){
+    destroyComputeKernel(&culler->kernel);
+    destroyBuffer(allocator, culler->drawBuffer, &culler->drawMemory);
+    destroyBuffer(allocator, culler->countBuffer, &culler->countMemory);
+}
+
+static inline void destroyInstanceRing(struct gpuAllocator* allocator, struct instanceRing* ring){
+    destroyBuffer(allocator, ring->buffer, &ring->allocation);
+    free(ring->base);
+    free(ring->host);
+}
+
+// types gives the descriptor type of each binding, storage buffers and storage images are supported
+static inline int createComputeKernel(struct descriptorCache* descriptors, VkPipelineCache cache, const char* shaderFile, const VkDescriptorType* types, uint32_t bindingCount, uint32_t pushSize, uint32_t maxSets, struct computeKernel* kernel){
+    memset(kernel, 0, sizeof(*kernel));
+    VkDevice device = descriptors->device;
+    if(bindingCount < 1 || bindingCount > COMPUTE_MAX_BINDINGS){
+        fprintf(stdout, "ERROR: COMPUTE KERNEL %s NEEDS 1 TO %d BINDINGS\n", shaderFile, COMPUTE_MAX_BINDINGS);
+        return 1;
+    }
+    kernel->device = device;
+    kernel->bindingCount = bindingCount;
+    kernel->pushSize = pushSize;
+    VkDescriptorSetLayoutBinding bindings[COMPUTE_MAX_BINDINGS];
+    uint32_t imageCount = 0;
+    for(uint32_t i = 0; i < bindingCount; i++){
+        kernel->types[i] = types[i];
+        if(types[i] == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) imageCount++;
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = types[i],
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+    }
+    if(descriptorLayoutGet(descriptors, bindings, NULL, bindingCount, 0, &kernel->setLayout)) return 1;
+    // pool sizes may not be empty, so only the types the kernel uses get one
+    VkDescriptorPoolSize poolSizes[2];
+    uint32_t poolSizeCount = 0;
+    if(bindingCount > imageCount) poolSizes[poolSizeCount++] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (bindingCount - imageCount) * maxSets};
+    if(imageCount) poolSizes[poolSizeCount++] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, imageCount * maxSets};
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = maxSets,
+        .poolSizeCount = poolSizeCount,
+        .pPoolSizes = poolSizes
+    };
+    if(vkCreateDescriptorPool(device, &poolInfo, NULL, &kernel->descriptorPool) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: COMPUTE DESCRIPTOR POOL CREATION FAILED\n");
+        return 1;
+    }
+    VkPushConstantRange pushRange = {.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = pushSize};
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &kernel->setLayout,
+        .pushConstantRangeCount = pushSize ? 1 : 0,
+        .pPushConstantRanges = pushSize ? &pushRange : NULL
+    };
+    if(vkCreatePipelineLayout(device, &layoutInfo, NULL, &kernel->layout) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: COMPUTE PIPELINE LAYOUT CREATION FAILED\n");
+        return 1;
+    }
+    VkShaderModule shader;
+    if(createShaderModule(device, shaderFile, &shader)) return 1;
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader,
+            .pName = "main"
+        },
+        .layout = kernel->layout
+    };
+    VkResult res = vkCreateComputePipelines(device, cache, 1, &pipelineInfo, NULL, &kernel->pipeline);
+    vkDestroyShaderModule(device, shader, NULL);
+    if(res != VK_SUCCESS){
+        fprintf(stdout, "ERROR: COMPUTE PIPELINE CREATION FAILED FOR %s\n", shaderFile);
+        return 1;
+    }
+    return 0;
+}
+
+// takes one of the kernel's maxSets sets and points binding i at bindings[i]
+static inline int computeKernelSet(struct computeKernel* kernel, const struct computeBinding* bindings, VkDescriptorSet* set){
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = kernel->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &kernel->setLayout
+    };
+    if(vkAllocateDescriptorSets(kernel->device, &setInfo, set) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: COMPUTE DESCRIPTOR SET ALLOCATION FAILED\n");
+        return 1;
+    }
+    VkDescriptorBufferInfo bufferInfos[COMPUTE_MAX_BINDINGS];
+    VkDescriptorImageInfo imageInfos[COMPUTE_MAX_BINDINGS];
+    VkWriteDescriptorSet writes[COMPUTE_MAX_BINDINGS];
+    for(uint32_t i = 0; i < kernel->bindingCount; i++){
+        uint32_t image = kernel->types[i] == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bufferInfos[i] = (VkDescriptorBufferInfo){bindings[i].buffer, bindings[i].offset, bindings[i].range};
+        imageInfos[i] = (VkDescriptorImageInfo){VK_NULL_HANDLE, bindings[i].view, VK_IMAGE_LAYOUT_GENERAL};
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = *set,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = kernel->types[i],
+            .pBufferInfo = image ? NULL : bufferInfos + i,
+            .pImageInfo = image ? imageInfos + i : NULL
+        };
+    }
+    vkUpdateDescriptorSets(kernel->device, kernel->bindingCount, writes, 0, NULL);
+    return 0;
+}
+
+// push holds pushSize bytes and is ignored by kernels without a push constant block
+static inline void recordDispatch(VkCommandBuffer commandBuffer, struct computeKernel* kernel, VkDescriptorSet set, const void* push, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ){
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->layout, 0, 1, &set, 0, NULL);
+    if(kernel->pushSize) vkCmdPushConstants(commandBuffer, kernel->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, kernel->pushSize, push);
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, groupsZ);
+}
+
+static inline void destroyComputeKernel(struct computeKernel* kernel){
+    vkDestroyPipeline(kernel->device, kernel->pipeline, NULL);
+    vkDestroyPipelineLayout(kernel->device, kernel->layout, NULL);
+    vkDestroyDescriptorPool(kernel->device, kernel->descriptorPool, NULL);
+}
+
+static inline int createComputeContext(struct gpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* props, struct qHandles* queues, struct syncLayer* sync, struct computeContext* context){
+    memset(context, 0, sizeof(*context));
+    context->allocator = allocator;
+    context->sync = sync;
+    if(createFamilyCommandPool(allocator->device, queues->computeFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &context->pool)) return 1;
+    if(createBuffer(allocator, COMPUTE_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &context->staging, &context->stagingMemory)) return 1;
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties queueFamilyProperties[queueFamilyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties);
+    uint32_t validBits = queueFamilyProperties[queues->computeFamily].timestampValidBits;
+    if(!validBits || props->limits.timestampPeriod == 0.0f) return 0;
+    context->validMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+    context->msPerTick = props->limits.timestampPeriod / 1000000.0;
+    VkQueryPoolCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2
+    };
+    if(vkCreateQueryPool(allocator->device, &createInfo, NULL, &context->queryPool) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: TIMESTAMP QUERY POOL CREATION FAILED\n");
+        return 1;
+    }
+    return 0;
+}
+
+// a host wait between two submissions orders them but makes nothing visible, so every run starts with a barrier on what earlier runs wrote
+static inline int computeBegin(struct computeContext* context, VkCommandBuffer* commandBuffer){
+    if(beginOneTimeCommands(context->allocator->device, context->pool, commandBuffer)) return 1;
+    VkMemoryBarrier previous = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &previous, 0, NULL, 0, NULL);
+    if(context->queryPool != VK_NULL_HANDLE){
+        vkCmdResetQueryPool(*commandBuffer, context->queryPool, 0, 2);
+        vkCmdWriteTimestamp(*commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, context->queryPool, 0);
+    }
+    return 0;
+}
+
+// submits to the compute queue and blocks until it is done, ms gets the time since computeBegin on the gpu clock when there is one
+static inline int computeEnd(struct computeContext* context, VkCommandBuffer commandBuffer, double* ms){
+    VkDevice device = context->allocator->device;
+    VkMemoryBarrier written = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &written, 0, NULL, 0, NULL);
+    if(context->queryPool != VK_NULL_HANDLE) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, context->queryPool, 1);
+    int res = 1;
+    uint64_t value;
+    double start = timeMs();
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO RECORD COMPUTE COMMAND BUFFER\n");
+    else if(!syncSubmit(context->sync, SYNC_COMPUTE, NULL, &commandBuffer, 1, VK_NULL_HANDLE, &value) && !syncWait(context->sync, SYNC_COMPUTE, value)) res = 0;
+    double cpuMs = timeMs() - start;
+    vkFreeCommandBuffers(device, context->pool, 1, &commandBuffer);
+    if(res || ms == NULL) return res;
+    *ms = cpuMs;
+    if(context->queryPool == VK_NULL_HANDLE) return 0;
+    uint64_t ticks[2];
+    if(vkGetQueryPoolResults(device, context->queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO READ TIMESTAMP QUERIES\n");
+        return 1;
+    }
+    *ms = ((ticks[1] - ticks[0]) & context->validMask) * context->msPerTick;
+    return 0;
+}
+
+// one dispatch on its own, the results can be read back as soon as it returns
+static inline int computeRun(struct computeContext* context, struct computeKernel* kernel, VkDescriptorSet set, const void* push, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, double* ms){
+    VkCommandBuffer commandBuffer;
+    if(computeBegin(context, &commandBuffer)) return 1;
+    recordDispatch(commandBuffer, kernel, set, push, groupsX, groupsY, groupsZ);
+    return computeEnd(context, commandBuffer, ms);
+}
+
+// goes through the staging buffer a piece at a time, dst needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+static inline int computeUpload(struct computeContext* context, VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size){
+    for(VkDeviceSize done = 0; done < size;){
+        VkDeviceSize piece = size - done < COMPUTE_STAGING_SIZE ? size - done : COMPUTE_STAGING_SIZE;
+        memcpy(context->stagingMemory.mapped, (const char*)data + done, piece);
+        VkCommandBuffer commandBuffer;
+        if(computeBegin(context, &commandBuffer)) return 1;
+        VkBufferCopy region = {0, offset + done, piece};
+        vkCmdCopyBuffer(commandBuffer, context->staging, dst, 1, &region);
+        if(computeEnd(context, commandBuffer, NULL)) return 1;
+        done += piece;
+    }
+    return 0;
+}
+
+// src needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+static inline int computeReadback(struct computeContext* context, VkBuffer src, VkDeviceSize offset, void* data, VkDeviceSize size){
+    for(VkDeviceSize done = 0; done < size;){
+        VkDeviceSize piece = size - done < COMPUTE_STAGING_SIZE ? size - done : COMPUTE_STAGING_SIZE;
+        VkCommandBuffer commandBuffer;
+        if(computeBegin(context, &commandBuffer)) return 1;
+        VkBufferCopy region = {offset + done, 0, piece};
+        vkCmdCopyBuffer(commandBuffer, src, context->staging, 1, &region);
+        if(computeEnd(context, commandBuffer, NULL)) return 1;
+        memcpy((char*)data + done, context->stagingMemory.mapped, piece);
+        done += piece;
+    }
+    return 0;
+}
+
+// sums megabytes of 32 bit values with reduce.comp and checks the result against the cpu
+// vulkan reports no memory bandwidth, so a buffer copy moving as many bytes on the same queue stands in for the peak
+static inline int computeBenchmark(struct computeContext* context, VkPhysicalDeviceProperties* props, struct descriptorCache* descriptors, VkPipelineCache cache, uint32_t megabytes){
+    VkPhysicalDeviceLimits* limits = &props->limits;
+    if(REDUCE_GROUP_SIZE > limits->maxComputeWorkGroupInvocations || REDUCE_GROUP_SIZE > limits->maxComputeWorkGroupSize[0] ||
+        REDUCE_GROUP_SIZE * sizeof(uint32_t) > limits->maxComputeSharedMemorySize){
+        fprintf(stdout, "ERROR: A REDUCTION WORKGROUP OF %d INVOCATIONS EXCEEDS THE DEVICE LIMITS\n", REDUCE_GROUP_SIZE);
+        return 1;
+    }
+    VkDeviceSize size = (VkDeviceSize)megabytes << 20;
+    // the whole input is one storage buffer binding
+    VkDeviceSize maxRange = limits->maxStorageBufferRange & ~(VkDeviceSize)15;
+    if(size > maxRange){
+        fprintf(stdout, "WARNING: maxStorageBufferRange IS %u BYTES, REDUCING %llu INSTEAD OF %u MB\n", limits->maxStorageBufferRange, (unsigned long long)maxRange, megabytes);
+        size = maxRange;
+    }
+    struct reducePush push = {(uint32_t)(size / 16)};
+    uint32_t groups = (push.count + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE;
+    if(groups > REDUCE_GROUPS) groups = REDUCE_GROUPS;
+    if(groups > limits->maxComputeWorkGroupCount[0]) groups = limits->maxComputeWorkGroupCount[0];
+
+    // everything below is released at cleanup, whichever step fails
+    int res = 1;
+    struct gpuAllocator* allocator = context->allocator;
+    VkBuffer input = VK_NULL_HANDLE, partials = VK_NULL_HANDLE;
+    struct gpuAllocation inputMemory, partialsMemory;
+    memset(&inputMemory, 0, sizeof(inputMemory));
+    memset(&partialsMemory, 0, sizeof(partialsMemory));
+    struct computeKernel kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    uint32_t* values = malloc(size);
+    if(values == NULL){
+        fprintf(stdout, "ERROR: REDUCTION INPUT MALLOC FAILED\n");
+        goto cleanup;
+    }
+    // sums wrap around the same way on both sides, so the check is exact
+    uint32_t expected = 0;
+    for(VkDeviceSize i = 0; i < size / sizeof(uint32_t); i++){
+        values[i] = (uint32_t)i * 2654435761u;
+        expected += values[i];
+    }
+    if(createBuffer(allocator, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &input, &inputMemory)) goto cleanup;
+    if(createBuffer(allocator, sizeof(uint32_t) * REDUCE_GROUPS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &partials, &partialsMemory)) goto cleanup;
+    if(computeUpload(context, input, 0, values, size)) goto cleanup;
+    free(values);
+    values = NULL;
+
+    VkDescriptorType types[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+    if(createComputeKernel(descriptors, cache, "shaders/reduce.spv", types, 2, sizeof(struct reducePush), 1, &kernel)) goto cleanup;
+    struct computeBinding bindings[2] = {
+        {input, 0, size, VK_NULL_HANDLE},
+        {partials, 0, sizeof(uint32_t) * groups, VK_NULL_HANDLE}
+    };
+    VkDescriptorSet set;
+    if(computeKernelSet(&kernel, bindings, &set)) goto cleanup;
+    // the first run of each is a warmup, the fastest of the rest counts
+    double reduceMs = 0.0, copyMs = 0.0;
+    for(uint32_t run = 0; run <= REDUCE_RUNS; run++){
+        double ms;
+        if(computeRun(context, &kernel, set, &push, groups, 1, 1, &ms)) goto cleanup;
+        if(run && (reduceMs == 0.0 || ms < reduceMs)) reduceMs = ms;
+    }
+    uint32_t sums[REDUCE_GROUPS];
+    if(computeReadback(context, partials, 0, sums, sizeof(uint32_t) * groups)) goto cleanup;
+    uint32_t total = 0;
+    for(uint32_t i = 0; i < groups; i++) total += sums[i];
+    // half of the input copied over the other half reads and writes as many bytes as the reduction reads
+    VkBufferCopy half = {0, size / 2, size / 2};
+    for(uint32_t run = 0; run <= REDUCE_RUNS; run++){
+        VkCommandBuffer commandBuffer;
+        double ms;
+        if(computeBegin(context, &commandBuffer)) goto cleanup;
+        vkCmdCopyBuffer(commandBuffer, input, input, 1, &half);
+        if(computeEnd(context, commandBuffer, &ms)) goto cleanup;
+        if(run && (copyMs == 0.0 || ms < copyMs)) copyMs = ms;
+    }
+    double reduceGBs = reduceMs > 0.0 ? size / (reduceMs * 1000000.0) : 0.0;
+    double copyGBs = copyMs > 0.0 ? size / (copyMs * 1000000.0) : 0.0;
+    fprintf(stdout, "Compute reduction: %llu MB in %.3f ms (%s clock), %.2f GB/s, %.0f%% of the %.2f GB/s a buffer copy moves, sum %s\n",
+        (unsigned long long)(size >> 20), reduceMs, context->queryPool != VK_NULL_HANDLE ? "gpu" : "cpu", reduceGBs,
+        copyGBs > 0.0 ? 100.0 * reduceGBs / copyGBs : 0.0, copyGBs, total == expected ? "matches the cpu" : "DIFFERS FROM THE CPU");
+    fprintf(stdout, "Compute limits: %d of %u invocations and %llu of %u bytes shared memory per workgroup, %u of %u workgroups, %llu of %u bytes per storage buffer\n",
+        REDUCE_GROUP_SIZE, limits->maxComputeWorkGroupInvocations, (unsigned long long)(REDUCE_GROUP_SIZE * sizeof(uint32_t)), limits->maxComputeSharedMemorySize,
+        groups, limits->maxComputeWorkGroupCount[0], (unsigned long long)size, limits->maxStorageBufferRange);
+    if(total != expected){
+        fprintf(stdout, "ERROR: REDUCTION RETURNED %u, EXPECTED %u\n", total, expected);
+        goto cleanup;
+    }
+    res = 0;
+cleanup:
+    free(values);
+    // a kernel that failed before it had a device created nothing
+    if(kernel.device != VK_NULL_HANDLE) destroyComputeKernel(&kernel);
+    destroyBuffer(allocator, input, &inputMemory);
+    destroyBuffer(allocator, partials, &partialsMemory);
+    return res;
+}
+
+static inline void destroyComputeContext(struct computeContext* context){
+    VkDevice device = context->allocator->device;
+    if(context->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, context->queryPool, NULL);
+    destroyBuffer(context->allocator, context->staging, &context->stagingMemory);
+    vkDestroyCommandPool(device, context->pool, NULL);
+}
+
+static inline int beginOneTimeCommands(VkDevice device, VkCommandPool pool, VkCommandBuffer* commandBuffer){
+    if(createCommandBuffer(device, pool, commandBuffer)) return 1;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if(vkBeginCommandBuffer(*commandBuffer, &beginInfo) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO BEGIN ONE TIME COMMAND BUFFER\n");
+        vkFreeCommandBuffers(device, pool, 1, commandBuffer);
+        return 1;
+    }
+    return 0;
+}
+
+// submits and blocks until the gpu is done, only meant for setup work
+static inline int endOneTimeCommands(VkDevice device, VkCommandPool pool, VkQueue queue, VkCommandBuffer commandBuffer){
+    int res = 1;
+    VkFence fence = VK_NULL_HANDLE;
+    VkFenceCreateInfo fenceInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer
+    };
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO END ONE TIME COMMAND BUFFER\n");
+    else if(vkCreateFence(device, &fenceInfo, NULL, &fence) != VK_SUCCESS) fprintf(stdout, "ERROR: FENCE CREATION FAILED\n");
+    else if(vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO SUBMIT ONE TIME COMMAND BUFFER\n");
+    else if(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO WAIT FOR ONE TIME COMMAND BUFFER\n");
+    else res = 0;
+    if(fence != VK_NULL_HANDLE) vkDestroyFence(device, fence, NULL);
+    vkFreeCommandBuffers(device, pool, 1, &commandBuffer);
+    return res;
+}
+
+// a gridSize of 0 gives the original triangle
+static inline int buildMesh(uint32_t gridSize, struct meshData* data){
+    uint32_t side = gridSize + 1;
+    data->vertexCount = gridSize ? side * side : 3;
+    data->indexCount = gridSize ? gridSize * gridSize * 6 : 3;
+    data->vertices = malloc(sizeof(struct vertex) * data->vertexCount);
+    data->indices = malloc(sizeof(uint32_t) * data->indexCount);
+    if(data->vertices == NULL || data->indices == NULL){
+        fprintf(stdout, "ERROR: MESH MALLOC FAILED\n");
+        freeMeshData(data);
+        return 1;
+    }
+    if(!gridSize){
+        struct vertex triangle[3] = {
+            {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+        };
+        memcpy(data->vertices, triangle, sizeof(triangle));
+        for(uint32_t i = 0; i < 3; i++) data->indices[i] = i;
+        return 0;
+    }
+    for(uint32_t y = 0; y < side; y++){
+        for(uint32_t x = 0; x < side; x++){
+            float u = (float)x / gridSize, v = (float)y / gridSize;
+            data->vertices[y * side + x] = (struct vertex){{u * 1.8f - 0.9f, v * 1.8f - 0.9f}, {u, v, 1.0f - u}};
+        }
+    }
+    uint32_t* index = data->indices;
+    for(uint32_t y = 0; y < gridSize; y++){
+        for(uint32_t x = 0; x < gridSize; x++){
+            uint32_t corner = y * side + x;
+            // clockwise like the triangle, so back face culling keeps them
+            *index++ = corner; *index++ = corner + 1; *index++ = corner + side;
+            *index++ = corner + 1; *index++ = corner + side + 1; *index++ = corner + side;
+        }
+    }
+    return 0;
+}
+
+static inline void freeMeshData(struct meshData* data){
+    free(data->vertices);
+    free(data->indices);
+    data->vertices = NULL;
+    data->indices = NULL;
+}
+
+// forsyth's linear-speed vertex cache optimisation scores
+static inline float vertexScore(int32_t cachePos, uint32_t valence){
+    if(valence == 0) return -1.0f; // no triangles left that need it
+    float score = 0.0f;
+    if(cachePos >= 0){
+        // the last triangle's vertices score the same so the next one does not have to reuse them in a fixed order
+        if(cachePos < 3) score = 0.75f;
+        else score = powf(1.0f - (float)(cachePos - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    // vertices with few triangles left are finished first so they can leave the cache
+    return score + 2.0f * powf((float)valence, -0.5f);
+}
+
+// greedily emits the best scoring triangle among those touching the simulated cache, reorders indices in place
+static inline int optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount){
+    uint32_t triangleCount = indexCount / 3;
+    uint32_t* valence = calloc(vertexCount, sizeof(uint32_t));    // triangles not yet emitted per vertex
+    uint32_t* adjacencyStart = malloc(sizeof(uint32_t) * (vertexCount + 1));
+    uint32_t* adjacency = malloc(sizeof(uint32_t) * indexCount);  // remaining triangles per vertex, packed
+    int32_t* cachePos = malloc(sizeof(int32_t) * vertexCount);
+    float* score = malloc(sizeof(float) * vertexCount);
+    float* triangleScore = malloc(sizeof(float) * triangleCount);
+    uint8_t* emitted = calloc(triangleCount, 1);
+    uint32_t* output = malloc(sizeof(uint32_t) * indexCount);
+    int res = 1;
+    if(!valence || !adjacencyStart || !adjacency || !cachePos || !score || !triangleScore || !emitted || !output){
+        fprintf(stdout, "ERROR: VERTEX CACHE OPTIMISATION MALLOC FAILED\n");
+        goto cleanup;
+    }
+    for(uint32_t i = 0; i < indexCount; i++) valence[indices[i]]++;
+    adjacencyStart[0] = 0;
+    for(uint32_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] = adjacencyStart[v] + valence[v];
+    memset(valence, 0, sizeof(uint32_t) * vertexCount);
+    for(uint32_t t = 0; t < triangleCount; t++){
+        for(uint32_t c = 0; c < 3; c++){
+            uint32_t v = indices[t * 3 + c];
+            adjacency[adjacencyStart[v] + valence[v]++] = t;
+        }
+    }
+    for(uint32_t v = 0; v < vertexCount; v++){
+        cachePos[v] = -1;
+        score[v] = vertexScore(-1, valence[v]);
+    }
+    uint32_t best = 0;
+    for(uint32_t t = 0; t < triangleCount; t++){
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        if(triangleScore[t] > triangleScore[best]) best = t;
+    }
+
+    uint32_t cache[VERTEX_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    uint32_t nextUnemitted = 0; // fallback scan position once nothing in the cache has triangles left
+    for(uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++){
+        if(best == UINT32_MAX){
+            while(emitted[nextUnemitted]) nextUnemitted++;
+            best = nextUnemitted;
+        }
+        const uint32_t* corners = indices + best * 3;
+        memcpy(output + emittedCount * 3, corners, sizeof(uint32_t) * 3);
+        emitted[best] = 1;
+
+        uint32_t newCache[VERTEX_CACHE_SIZE + 3];
+        uint32_t newCount = 0;
+        for(uint32_t c = 0; c < 3; c++){
+            uint32_t v = corners[c];
+            uint32_t* list = adjacency + adjacencyStart[v];
+            for(uint32_t i = 0; i < valence[v]; i++){
+                if(list[i] == best){
+                    list[i] = list[--valence[v]];
+                    break;
+                }
+            }
+            if(newCount == 0 || newCache[newCount - 1] != v) newCache[newCount++] = v; // only consecutive duplicates in degenerate triangles
+        }
+        for(uint32_t i = 0; i < cacheCount; i++){
+            uint32_t v = cache[i];
+            if(v != corners[0] && v != corners[1] && v != corners[2]) newCache[newCount++] = v;
+        }
+        // vertices pushed past the end get their score recomputed as evicted before being dropped
+        for(uint32_t i = 0; i < newCount; i++){
+            uint32_t v = newCache[i];
+            cachePos[v] = i < VERTEX_CACHE_SIZE ? (int32_t)i : -1;
+            score[v] = vertexScore(cachePos[v], valence[v]);
+        }
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for(uint32_t i = 0; i < newCount; i++){
+            uint32_t v = newCache[i];
+            const uint32_t* list = adjacency + adjacencyStart[v];
+            for(uint32_t j = 0; j < valence[v]; j++){
+                uint32_t t = list[j];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if(triangleScore[t] > bestScore){
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+        memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+    }
+    memcpy(indices, output, sizeof(uint32_t) * indexCount);
+    res = 0;
+cleanup:
+    free(valence);
+    free(adjacencyStart);
+    free(adjacency);
+    free(cachePos);
+    free(score);
+    free(triangleScore);
+    free(emitted);
+    free(output);
+    return res;
+}
+
+// renumbers vertices in the order the indices first use them so fetches walk memory forwards, unused vertices are dropped
+static inline int optimizeVertexFetch(struct meshData* data){
+    uint32_t* remap = malloc(sizeof(uint32_t) * data->vertexCount);
+    struct vertex* vertices = malloc(sizeof(struct vertex) * data->vertexCount);
+    if(remap == NULL || vertices == NULL){
+        fprintf(stdout, "ERROR: VERTEX FETCH OPTIMISATION MALLOC FAILED\n");
+        free(remap);
+        free(vertices);
+        return 1;
+    }
+    memset(remap, 0xFF, sizeof(uint32_t) * data->vertexCount);
+    uint32_t next = 0;
+    for(uint32_t i = 0; i < data->indexCount; i++){
+        uint32_t v = data->indices[i];
+        if(remap[v] == UINT32_MAX){
+            remap[v] = next;
+            vertices[next++] = data->vertices[v];
+        }
+        data->indices[i] = remap[v];
+    }
+    free(remap);
+    free(data->vertices);
+    data->vertices = vertices;
+    data->vertexCount = next;
+    return 0;
+}
+
+// transformed vertices per triangle with a fifo post-transform cache, 0.5 is the best a regular grid can do
+static inline double vertexCacheMissRatio(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize){
+    uint32_t* insertedAt = malloc(sizeof(uint32_t) * vertexCount); // miss count when the vertex entered the cache
+    if(insertedAt == NULL || indexCount < 3){
+        free(insertedAt);
+        return 0.0;
+    }
+    memset(insertedAt, 0xFF, sizeof(uint32_t) * vertexCount);
+    uint32_t misses = 0;
+    for(uint32_t i = 0; i < indexCount; i++){
+        uint32_t v = indices[i];
+        if(insertedAt[v] == UINT32_MAX || misses - insertedAt[v] >= cacheSize) insertedAt[v] = misses++;
+    }
+    free(insertedAt);
+    return (double)misses / (indexCount / 3);
+}
+
+// core features and entry points go by this rather than the device's own version
+static inline uint32_t deviceApiVersion(VkPhysicalDevice device){
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+    return props.apiVersion < instanceApiVersion ? props.apiVersion : instanceApiVersion;
+}
+
+// core in 1.2, VK_KHR_timeline_semaphore before that, the feature has to be there either way
+static inline int timelineSemaphoreSupported(VkPhysicalDevice device){
+    if(deviceApiVersion(device) < VK_API_VERSION_1_2 && !deviceExtensionSupported(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) return 0;
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    VkPhysicalDeviceFeatures2 features2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &timeline};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    return timeline.timelineSemaphore;
+}
+
+// roles sharing a family share a VkQueue but keep their own timeline, submission order on the queue keeps them consistent
+static inline int createSyncLayer(VkDevice device, struct qHandles* queues, struct syncLayer* sync){
+    memset(sync, 0, sizeof(*sync));
+    sync->device = device;
+    sync->waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+    sync->counterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+    if(sync->waitSemaphores == NULL) sync->waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    if(sync->counterValue == NULL) sync->counterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    if(sync->waitSemaphores == NULL || sync->counterValue == NULL){
+        fprintf(stdout, "ERROR: TIMELINE SEMAPHORE FUNCTIONS NOT FOUND\n");
+        return 1;
+    }
+    sync->timelines[SYNC_GRAPHICS].queue = queues->graphics;
+    sync->timelines[SYNC_COMPUTE].queue = queues->compute;
+    sync->timelines[SYNC_TRANSFER].queue = queues->transfer;
+    VkSemaphoreTypeCreateInfo typeInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphoreInfo = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &typeInfo};
+    for(uint32_t i = 0; i < SYNC_QUEUE_COUNT; i++){
+        if(vkCreateSemaphore(device, &semaphoreInfo, NULL, &sync->timelines[i].semaphore) != VK_SUCCESS){
+            fprintf(stdout, "ERROR: FAILED TO CREATE TIMELINE SEMAPHORE\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void syncWaitBinary(struct syncWaits* waits, VkSemaphore semaphore, VkPipelineStageFlags stage){
+    waits->semaphores[waits->count] = semaphore;
+    waits->values[waits->count] = 0;
+    waits->stages[waits->count++] = stage;
+}
+
+// value 0 is always reached and adds nothing
+static inline void syncWaitTimeline(struct syncWaits* waits, struct syncLayer* sync, uint32_t queue, uint64_t value, VkPipelineStageFlags stage){
+    if(value == 0) return;
+    waits->semaphores[waits->count] = sync->timelines[queue].semaphore;
+    waits->values[waits->count] = value;
+    waits->stages[waits->count++] = stage;
+}
+
+// signals the next value of queue's timeline, and binarySignal too unless it is VK_NULL_HANDLE, value gets the timeline value
+static inline int syncSubmit(struct syncLayer* sync, uint32_t queue, struct syncWaits* waits, VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, VkSemaphore binarySignal, uint64_t* value){
+    struct queueTimeline* timeline = sync->timelines + queue;
+    uint64_t signalValues[2] = {timeline->submitted + 1, 0};
+    VkSemaphore signals[2] = {timeline->semaphore, binarySignal};
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = waits ? waits->count : 0,
+        .pWaitSemaphoreValues = waits ? waits->values : NULL,
+        .signalSemaphoreValueCount = binarySignal != VK_NULL_HANDLE ? 2 : 1,
+        .pSignalSemaphoreValues = signalValues
+    };
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount,
+        .pWaitSemaphores = waits ? waits->semaphores : NULL,
+        .pWaitDstStageMask = waits ? waits->stages : NULL,
+        .commandBufferCount = commandBufferCount,
+        .pCommandBuffers = commandBuffers,
+        .signalSemaphoreCount = timelineInfo.signalSemaphoreValueCount,
+        .pSignalSemaphores = signals
+    };
+    if(vkQueueSubmit(timeline->queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO SUBMIT QUEUE\n");
+        return 1;
+    }
+    *value = ++timeline->submitted;
+    return 0;
+}
+
+// reads the counter back from the device, cheaper than a wait and never blocks
+static inline uint64_t syncCompleted(struct syncLayer* sync, uint32_t queue){
+    struct queueTimeline* timeline = sync->timelines + queue;
+    uint64_t value;
+    if(timeline->completed < timeline->submitted && sync->counterValue(sync->device, timeline->semaphore, &value) == VK_SUCCESS) timeline->completed = value;
+    return timeline->completed;
+}
+
+static inline int syncReached(struct syncLayer* sync, uint32_t queue, uint64_t value){
+    return value <= sync->timelines[queue].completed || value <= syncCompleted(sync, queue);
+}
+
+static inline int syncWait(struct syncLayer* sync, uint32_t queue, uint64_t value){
+    if(syncReached(sync, queue, value)) return 0;
+    struct queueTimeline* timeline = sync->timelines + queue;
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline->semaphore,
+        .pValues = &value
+    };
+    sync->hostWaits++;
+    if(sync->waitSemaphores(sync->device, &waitInfo, UINT64_MAX) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO WAIT FOR TIMELINE VALUE %llu\n", (unsigned long long)value);
+        return 1;
+    }
+    if(value > timeline->completed) timeline->completed = value;
+    return 0;
+}
+
+static inline void destroySyncLayer(struct syncLayer* sync){
+    for(uint32_t i = 0; i < SYNC_QUEUE_COUNT; i++) vkDestroySemaphore(sync->device, sync->timelines[i].semaphore, NULL);
+}
+
+static inline int createUploadContext(VkDevice device, struct qHandles* queues, struct uploadContext* upload){
+    memset(upload, 0, sizeof(*upload));
+    upload->queues = queues;
+    if(createFamilyCommandPool(device, queues->transferFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &upload->transferPool)) return 1;
+    if(queues->transferFamily == queues->graphicsFamily) return 0;
+    if(createFamilyCommandPool(device, queues->graphicsFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &upload->graphicsPool)) return 1;
+    VkSemaphoreCreateInfo semaphoreInfo = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    if(vkCreateSemaphore(device, &semaphoreInfo, NULL, &upload->released) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO CREATE UPLOAD SEMAPHORE\n");
+        return 1;
+    }
+    return 0;
+}
+
+// ends commandBuffer from transferPool and makes the copied ranges in handoffs visible to dstStage on the graphics queue
+// handoffs only need buffer, offset, size and dstAccessMask filled in
+// blocks until the graphics queue owns the data, only meant for setup work
+static inline int submitUpload(VkDevice device, struct uploadContext* upload, VkCommandBuffer commandBuffer, VkBufferMemoryBarrier* handoffs, uint32_t handoffCount, VkPipelineStageFlags dstStage){
+    struct qHandles* queues = upload->queues;
+    uint32_t separate = queues->transferFamily != queues->graphicsFamily;
+    for(uint32_t i = 0; i < handoffCount; i++){
+        handoffs[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        handoffs[i].pNext = NULL;
+        handoffs[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        handoffs[i].srcQueueFamilyIndex = separate ? queues->transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        handoffs[i].dstQueueFamilyIndex = separate ? queues->graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    }
+    // on a separate family this is the release, its destination access is ignored
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, separate ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : dstStage, 0, 0, NULL, handoffCount, handoffs, 0, NULL);
+    if(!separate) return endOneTimeCommands(device, upload->transferPool, queues->transfer, commandBuffer);
+
+    VkCommandBuffer acquire;
+    int res = 1;
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO END UPLOAD COMMAND BUFFER\n");
+        vkFreeCommandBuffers(device, upload->transferPool, 1, &commandBuffer);
+        return 1;
+    }
+    VkSubmitInfo transferSubmit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &upload->released
+    };
+    if(vkQueueSubmit(queues->transfer, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO SUBMIT UPLOAD\n");
+    else if(beginOneTimeCommands(device, upload->graphicsPool, &acquire) == 0){
+        for(uint32_t i = 0; i < handoffCount; i++) handoffs[i].srcAccessMask = 0;
+        vkCmdPipelineBarrier(acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, NULL, handoffCount, handoffs, 0, NULL);
+        // the acquire waits on the release, the fence then covers both submits
+        VkFence fence = VK_NULL_HANDLE;
+        VkFenceCreateInfo fenceInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkSubmitInfo acquireSubmit = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &upload->released,
+            .pWaitDstStageMask = &dstStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &acquire
+        };
+        if(vkEndCommandBuffer(acquire) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO END ACQUIRE COMMAND BUFFER\n");
+        else if(vkCreateFence(device, &fenceInfo, NULL, &fence) != VK_SUCCESS) fprintf(stdout, "ERROR: FENCE CREATION FAILED\n");
+        else if(vkQueueSubmit(queues->graphics, 1, &acquireSubmit, fence) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO SUBMIT ACQUIRE\n");
+        else if(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) fprintf(stdout, "ERROR: FAILED TO WAIT FOR UPLOAD\n");
+        else res = 0;
+        if(fence != VK_NULL_HANDLE) vkDestroyFence(device, fence, NULL);
+        vkFreeCommandBuffers(device, upload->graphicsPool, 1, &acquire);
+    }
+    // a failed submit may leave the transfer pending, nothing is freed until it is done
+    if(res) vkQueueWaitIdle(queues->transfer);
+    vkFreeCommandBuffers(device, upload->transferPool, 1, &commandBuffer);
+    return res;
+}
+
+static inline void destroyUploadContext(VkDevice device, struct uploadContext* upload){
+    vkDestroyCommandPool(device, upload->transferPool, NULL);
+    if(upload->graphicsPool != VK_NULL_HANDLE) vkDestroyCommandPool(device, upload->graphicsPool, NULL);
+    if(upload->released != VK_NULL_HANDLE) vkDestroySemaphore(device, upload->released, NULL);
+}
+
+static inline int createUploadStream(struct gpuAllocator* allocator, struct qHandles* queues, struct syncLayer* sync, VkDeviceSize ringSize, VkDeviceSize bytesPerFrame, struct uploadStream* stream){
+    VkDevice device = allocator->device;
+    memset(stream, 0, sizeof(*stream));
+    stream->device = device;
+    stream->sync = sync;
+    stream->transferFamily = queues->transferFamily;
+    stream->graphicsFamily = queues->graphicsFamily;
+    stream->ringSize = ringSize;
+    stream->bytesPerFrame = bytesPerFrame;
+    if(createBuffer(allocator, ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &stream->ring, &stream->ringMemory)) return 1;
+    if(createFamilyCommandPool(device, queues->transferFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, &stream->pool)) return 1;
+    for(uint32_t i = 0; i < STREAM_BATCHES; i++){
+        if(createCommandBuffer(device, stream->pool, &stream->batches[i].commandBuffer)) return 1;
+    }
+    return 0;
+}
+
+static inline uint64_t streamQueue(struct uploadStream* stream, struct streamRequest* request){
+    if(stream->requestCount == stream->requestCapacity){
+        uint32_t capacity = stream->requestCapacity ? stream->requestCapacity * 2 : 64;
+        struct streamRequest* grown = realloc(stream->requests, sizeof(struct streamRequest) * capacity);
+        if(grown == NULL){
+            fprintf(stdout, "ERROR: UPLOAD REQUEST MALLOC FAILED\n");
+            return 0;
+        }
+        stream->requests = grown;
+        stream->requestCapacity = capacity;
+    }
+    request->done = 0;
+    request->ticket = ++stream->nextTicket;
+    stream->requests[stream->requestCount++] = *request;
+    return request->ticket;
+}
+
+// returns the ticket to poll or wait on, 0 on failure, nothing is copied until the next streamSubmit
+static inline uint64_t streamUploadBuffer(struct uploadStream* stream, VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size){
+    if(size == 0){
+        fprintf(stdout, "ERROR: EMPTY UPLOAD\n");
+        return 0;
+    }
+    struct streamRequest request = {.buffer = buffer, .dstOffset = offset, .data = data, .size = size};
+    return streamQueue(stream, &request);
+}
+
+// whole color image of an uncompressed format, mip 0 and layer 0, left in finalLayout
+// copied in one piece so it has to fit the ring, it may go over the per-frame budget when it is the first thing in a batch
+static inline uint64_t streamUploadImage(struct uploadStream* stream, VkImage image, VkExtent3D extent, uint32_t texelSize, VkImageLayout finalLayout, const void* data, VkDeviceSize size){
+    if(size == 0 || size > stream->ringSize){
+        fprintf(stdout, "ERROR: IMAGE UPLOAD OF %llu BYTES DOES NOT FIT THE %llu BYTE STAGING RING\n", (unsigned long long)size, (unsigned long long)stream->ringSize);
+        return 0;
+    }
+    if(texelSize == 0 || size != (VkDeviceSize)extent.width * extent.height * extent.depth * texelSize){
+        fprintf(stdout, "ERROR: IMAGE UPLOAD OF %llu BYTES DOES NOT MATCH ITS EXTENT AND %u BYTE TEXELS\n", (unsigned long long)size, texelSize);
+        return 0;
+    }
+    // vkCmdCopyBufferToImage wants bufferOffset to be a multiple of the texel size and of 4
+    VkDeviceSize alignment = texelSize % 4 == 0 ? texelSize : texelSize % 2 == 0 ? texelSize * 2 : texelSize * 4;
+    struct streamRequest request = {.image = image, .extent = extent, .finalLayout = finalLayout, .alignment = alignment, .data = data, .size = size};
+    return streamQueue(stream, &request);
+}
+
+// retires finished batches in submission order without blocking
+static inline void streamRetire(struct uploadStream* stream){
+    if(stream->completed == stream->submitted) return;
+    uint64_t reached = syncCompleted(stream->sync, SYNC_TRANSFER);
+    while(stream->completed < stream->submitted){
+        struct streamBatch* batch = stream->batches + stream->completed % STREAM_BATCHES;
+        if(batch->value > reached) return;
+        stream->tail = batch->ringEnd;
+        stream->completedTicket = batch->lastTicket;
+        stream->completed++;
+    }
+}
+
+static inline void streamFlushRegions(struct uploadStream* stream, VkCommandBuffer commandBuffer){
+    if(stream->regionCount == 0) return;
+    vkCmdCopyBuffer(commandBuffer, stream->ring, stream->regionDst, stream->regionCount, stream->regions);
+    stream->copyCommands++;
+    stream->copyRegions += stream->regionCount;
+    stream->regionCount = 0;
+}
+
+static inline void streamCopyImage(struct uploadStream* stream, VkCommandBuffer commandBuffer, struct streamRequest* request, VkDeviceSize ringOffset){
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = request->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+    VkBufferImageCopy region = {
+        .bufferOffset = ringOffset,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = request->extent
+    };
+    vkCmdCopyBufferToImage(commandBuffer, stream->ring, request->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    // on one family the semaphore the consumer waits on makes the write visible and the barrier only orders the layout change
+    // on a separate one it is the release, the graphics family owns the image once streamRecordAcquires' matching barrier runs
+    uint32_t separate = stream->transferFamily != stream->graphicsFamily;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = request->finalLayout;
+    barrier.srcQueueFamilyIndex = separate ? stream->transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = separate ? stream->graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+    if(separate){
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        stream->acquires[stream->acquireCount++] = barrier;
+    }
+    stream->copyCommands++;
+    stream->copyRegions++;
+}
+
+// copies queued data into the ring up to the per-frame budget and submits it as one batch, never blocks
+// value, when not NULL, gets the transfer timeline value work using the data has to wait for, 0 if nothing was submitted
+static inline int streamSubmit(struct uploadStream* stream, uint64_t* value){
+    if(value) *value = 0;
+    streamRetire(stream);
+    if(stream->requestHead == stream->requestCount) return 0;
+    if(stream->submitted - stream->completed == STREAM_BATCHES){
+        stream->stalls++;
+        return 0;
+    }
+    struct streamBatch* batch = stream->batches + stream->submitted % STREAM_BATCHES;
+    VkDeviceSize budget = stream->bytesPerFrame ? stream->bytesPerFrame : ~(VkDeviceSize)0;
+    VkDeviceSize taken = 0;
+    uint32_t recording = 0;
+    uint32_t released = stream->acquireCount;
+    while(stream->requestHead < stream->requestCount && taken < budget){
+        struct streamRequest* request = stream->requests + stream->requestHead;
+        VkDeviceSize size = request->size - request->done;
+        if(request->image != VK_NULL_HANDLE && stream->acquireCount == STREAM_MAX_ACQUIRES){
+            stream->stalls++;
+            break;
+        }
+        if(request->image != VK_NULL_HANDLE && taken && size > budget - taken) break;
+        if(request->image == VK_NULL_HANDLE && size > budget - taken) size = budget - taken;
+        uint64_t pos = (stream->head + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+        if(request->image != VK_NULL_HANDLE){
+            // a 12 or 24 byte texel does not divide ringSize, so the ring offset is rounded rather than pos
+            // an image that would then run past the end starts over at offset 0, which suits any texel size
+            VkDeviceSize offset = pos % stream->ringSize;
+            VkDeviceSize aligned = (offset + request->alignment - 1) / request->alignment * request->alignment;
+            pos += aligned + size > stream->ringSize ? stream->ringSize - offset : aligned - offset;
+        }
+        VkDeviceSize contiguous = stream->ringSize - pos % stream->ringSize;
+        if(request->image != VK_NULL_HANDLE && size > contiguous) pos += contiguous;
+        else if(size > contiguous) size = contiguous;
+        VkDeviceSize space = pos - stream->tail >= stream->ringSize ? 0 : stream->ringSize - (pos - stream->tail);
+        if(size > space) size = request->image != VK_NULL_HANDLE ? 0 : space;
+        if(size == 0){
+            stream->stalls++;
+            break;
+        }
+        if(!recording){
+            VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            };
+            if(vkBeginCommandBuffer(batch->commandBuffer, &beginInfo) != VK_SUCCESS){
+                fprintf(stdout, "ERROR: FAILED TO BEGIN UPLOAD BATCH\n");
+                return 1;
+            }
+            recording = 1;
+        }
+        VkDeviceSize ringOffset = pos % stream->ringSize;
+        memcpy((char*)stream->ringMemory.mapped + ringOffset, request->data + request->done, size);
+        stream->head = pos + size;
+        taken += size;
+        if(request->image != VK_NULL_HANDLE){
+            streamFlushRegions(stream, batch->commandBuffer);
+            streamCopyImage(stream, batch->commandBuffer, request, ringOffset);
+        } else {
+            if(stream->regionCount == STREAM_MAX_REGIONS || (stream->regionCount && stream->regionDst != request->buffer)) streamFlushRegions(stream, batch->commandBuffer);
+            stream->regionDst = request->buffer;
+            stream->regions[stream->regionCount++] = (VkBufferCopy){ringOffset, request->dstOffset + request->done, size};
+        }
+        request->done += size;
+        if(request->done == request->size){
+            stream->submittedTicket = request->ticket;
+            stream->requestHead++;
+        }
+    }
+    if(!recording) return 0;
+    streamFlushRegions(stream, batch->commandBuffer);
+    if(vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO RECORD UPLOAD BATCH\n");
+        return 1;
+    }
+    if(syncSubmit(stream->sync, SYNC_TRANSFER, NULL, &batch->commandBuffer, 1, VK_NULL_HANDLE, &batch->value)) return 1;
+    stream->submitted++;
+    if(stream->acquireCount != released) stream->acquireValue = batch->value;
+    batch->ringEnd = stream->head;
+    batch->lastTicket = stream->submittedTicket;
+    if(value) *value = batch->value;
+    if(stream->requestHead == stream->requestCount) stream->requestHead = stream->requestCount = 0;
+    stream->bytes += taken;
+    if(taken > stream->maxBatchBytes) stream->maxBatchBytes = taken;
+    return 0;
+}
+
+// begins and ends commandBuffer, from a graphics family pool, with the acquiring half of every image released so far
+// the submission holding it has to wait at STREAM_WAIT_STAGES for value on the transfer timeline
+static inline int streamRecordAcquires(struct uploadStream* stream, VkCommandBuffer commandBuffer, uint64_t* value){
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO BEGIN IMAGE ACQUIRE\n");
+        return 1;
+    }
+    vkCmdPipelineBarrier(commandBuffer, STREAM_WAIT_STAGES, STREAM_WAIT_STAGES, 0, 0, NULL, 0, NULL, stream->acquireCount, stream->acquires);
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO RECORD IMAGE ACQUIRE\n");
+        return 1;
+    }
+    *value = stream->acquireValue;
+    stream->acquireCount = 0;
+    return 0;
+}
+
+// 1 once the gpu has finished the upload, also reclaims the ring space of everything that finished
+static inline int streamPoll(struct uploadStream* stream, uint64_t ticket){
+    streamRetire(stream);
+    return ticket <= stream->completedTicket;
+}
+
+// blocks until ticket is done, submitting whatever is still queued in front of it, for loading screens and teardown
+static inline int streamWait(struct uploadStream* stream, uint64_t ticket){
+    while(!streamPoll(stream, ticket)){
+        uint64_t submitted = stream->submitted;
+        if(stream->submittedTicket < ticket && streamSubmit(stream, NULL)) return 1;
+        if(stream->submitted != submitted) continue;
+        if(stream->completed == stream->submitted){
+            fprintf(stdout, "ERROR: UPLOAD TICKET %llu WAS NEVER QUEUED\n", (unsigned long long)ticket);
+            return 1;
+        }
+        if(syncWait(stream->sync, SYNC_TRANSFER, stream->batches[stream->completed % STREAM_BATCHES].value)) return 1;
+    }
+    return 0;
+}
+
+static inline void destroyUploadStream(struct gpuAllocator* allocator, struct uploadStream* stream){
+    vkDestroyCommandPool(stream->device, stream->pool, NULL);
+    destroyBuffer(allocator, stream->ring, &stream->ringMemory);
+    free(stream->requests);
+}
+
+// vertices and indices go through one host visible staging buffer into device local memory
+static inline int uploadMesh(struct gpuAllocator* allocator, struct uploadContext* upload, struct meshData* data, uint32_t vertexLayout, uint32_t indexBits, struct mesh* mesh){
+    VkDevice device = allocator->device;
+    if(indexBits == 0) indexBits = data->vertexCount <= 0x10000 ? 16 : 32;
+    if(indexBits == 16 && data->vertexCount > 0x10000){
+        fprintf(stdout, "ERROR: %u VERTICES DO NOT FIT 16 BIT INDICES\n", data->vertexCount);
+        return 1;
+    }
+    VkDeviceSize vertexSize = sizeof(struct vertex) * (VkDeviceSize)data->vertexCount;
+    VkDeviceSize indexSize = (VkDeviceSize)(indexBits / 8) * data->indexCount;
+    mesh->indexType = indexBits == 16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    mesh->indexCount = data->indexCount;
+    mesh->vertexCount = data->vertexCount;
+    mesh->streamCount = vertexLayout == VERTEX_LAYOUT_SPLIT ? 2 : 1;
+    mesh->streamOffsets[0] = 0;
+    mesh->streamOffsets[1] = sizeof(((struct vertex*)0)->pos) * (VkDeviceSize)data->vertexCount;
+
+    VkBuffer staging;
+    struct gpuAllocation stagingMemory;
+    if(createBuffer(allocator, vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, &stagingMemory)) return 1;
+    char* dst = stagingMemory.mapped;
+    if(vertexLayout == VERTEX_LAYOUT_SPLIT){
+        float* positions = (float*)dst;
+        float* colors = (float*)(dst + mesh->streamOffsets[1]);
+        for(uint32_t i = 0; i < data->vertexCount; i++){
+            memcpy(positions + i * 2, data->vertices[i].pos, sizeof(data->vertices[i].pos));
+            memcpy(colors + i * 3, data->vertices[i].color, sizeof(data->vertices[i].color));
+        }
+    } else memcpy(dst, data->vertices, vertexSize);
+    if(indexBits == 16){
+        uint16_t* indices = (uint16_t*)(dst + vertexSize);
+        for(uint32_t i = 0; i < data->indexCount; i++) indices[i] = (uint16_t)data->indices[i];
+    } else memcpy(dst + vertexSize, data->indices, indexSize);
+
+    if(createBuffer(allocator, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->vertexBuffer, &mesh->vertexMemory)) return 1;
+    if(createBuffer(allocator, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->indexBuffer, &mesh->indexMemory)) return 1;
+
+    VkCommandBuffer commandBuffer;
+    if(beginOneTimeCommands(device, upload->transferPool, &commandBuffer)) return 1;
+    VkBufferCopy vertexCopy = {.srcOffset = 0, .dstOffset = 0, .size = vertexSize};
+    VkBufferCopy indexCopy = {.srcOffset = vertexSize, .dstOffset = 0, .size = indexSize};
+    vkCmdCopyBuffer(commandBuffer, staging, mesh->vertexBuffer, 1, &vertexCopy);
+    vkCmdCopyBuffer(commandBuffer, staging, mesh->indexBuffer, 1, &indexCopy);
+    VkBufferMemoryBarrier handoffs[2] = {
+        {.buffer = mesh->vertexBuffer, .offset = 0, .size = VK_WHOLE_SIZE, .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT},
+        {.buffer = mesh->indexBuffer, .offset = 0, .size = VK_WHOLE_SIZE, .dstAccessMask = VK_ACCESS_INDEX_READ_BIT}
+    };
+    int res = submitUpload(device, upload, commandBuffer, handoffs, 2, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    destroyBuffer(allocator, staging, &stagingMemory);
+    return res;
+}
+
+static inline void destroyMesh(struct gpuAllocator* allocator, struct mesh* mesh){
+    destroyBuffer(allocator, mesh->vertexBuffer, &mesh->vertexMemory);
+    destroyBuffer(allocator, mesh->indexBuffer, &mesh->indexMemory);
+}
+
+// secondaries inherit nothing from the primary so every slice binds its own state
+static inline void recordDraws(VkCommandBuffer commandBuffer, VkPipeline graphicsPipeline, VkExtent2D extent, struct drawList* draws, uint32_t frameSlot, uint32_t first, uint32_t count){
+    struct mesh* mesh = draws->mesh;
+    struct instanceRing* instances = draws->instances;
+    struct gpuCuller* culler = draws->culler;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline );
+    // bound in every secondary too, bindings are not inherited
+    struct frameDescriptors* descriptors = draws->descriptors;
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draws->layout, 0, 1, descriptors->sets + frameSlot,
+        descriptors->mode == DESCRIPTOR_MODE_DYNAMIC, descriptors->offsets + frameSlot);
+    if(draws->bindless) vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draws->layout, 1, 1, &draws->bindless->set, 0, NULL);
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)(extent.width),
+        .height = (float)(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer,0,1,&viewport);
+
+    VkRect2D scissor = {
+        .extent = extent,
+        .offset = {0, 0}
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkBuffer streams[MAX_VERTEX_STREAMS] = {mesh->vertexBuffer, mesh->vertexBuffer};
+    VkDeviceSize instanceOffset = instances->sliceSize * frameSlot;
+    vkCmdBindVertexBuffers(commandBuffer, 0, mesh->streamCount, streams, mesh->streamOffsets);
+    if(draws->drawData == DRAW_DATA_INSTANCED) vkCmdBindVertexBuffers(commandBuffer, mesh->streamCount, 1, &instances->buffer, &instanceOffset);
+    vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer, 0, mesh->indexType);
+    if(draws->drawData == DRAW_DATA_PUSH){
+        // nothing is written to memory for these, the payload travels in the command buffer
+        for(uint32_t i = first; i < first + count; i++){
+            struct instanceData* instance = instances->host + i;
+            struct drawConstants constants = {
+                {instance->transform[0], instance->transform[1], instance->transform[2]}, i,
+                {instance->color[0], instance->color[1], instance->color[2], 1.0f}
+            };
+            vkCmdPushConstants(commandBuffer, draws->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+            vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, 0);
+        }
+    } else if(draws->drawData == DRAW_DATA_UNIFORM){
+        // the set stays the same, only the dynamic offset moves from one draw to the next
+        struct frameDescriptors* drawUniforms = draws->drawUniforms;
+        VkDeviceSize stride = drawUniformStride(drawUniforms->alignment);
+        for(uint32_t i = first; i < first + count; i++){
+            uint32_t offset = drawUniforms->offsets[frameSlot] + (uint32_t)(stride * i);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draws->layout, 2, 1, drawUniforms->sets + frameSlot, 1, &offset);
+            vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, 0);
+        }
+    } else if(culler){
+        // one command per object, culled ones draw zero instances
+        VkDeviceSize drawOffset = culler->drawSlice * frameSlot;
+        for(uint32_t start = 0; start < instances->instanceCount; start += culler->maxDrawCount){
+            uint32_t batch = instances->instanceCount - start < culler->maxDrawCount ? instances->instanceCount - start : culler->maxDrawCount;
+            vkCmdDrawIndexedIndirect(commandBuffer, culler->drawBuffer, drawOffset + sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)start,
+                batch, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    } else if(draws->separateDraws){
+        for(uint32_t i = first; i < first + count; i++) vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, i);
+    } else vkCmdDrawIndexed(commandBuffer, mesh->indexCount, count, 0, 0, first);
+}
+
+static inline int recordSecondary(struct recordWorker* worker, struct recordJob* job){
+    struct recordPool* pool = worker->pool;
+    uint32_t slice = (job->drawCount + pool->threadCount - 1) / pool->threadCount;
+    uint32_t first = slice * worker->index;
+    uint32_t count = first >= job->drawCount ? 0 : (job->drawCount - first < slice ? job->drawCount - first : slice);
+    VkCommandBuffer commandBuffer = worker->secondary[job->frameSlot];
+    vkResetCommandPool(pool->device, worker->commandPools[job->frameSlot], 0);
+    VkCommandBufferInheritanceRenderingInfo renderingInheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &job->colorFormat,
+        .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = job->renderPass == VK_NULL_HANDLE ? &renderingInheritance : NULL,
+        .renderPass = job->renderPass,
+        .subpass = 0,
+        .framebuffer = job->framebuffer
+    };
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &inheritance
+    };
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO BEGIN SECONDARY COMMAND BUFFER ON THREAD %u\n", worker->index);
+        return 1;
+    }
+    recordDraws(commandBuffer, job->pipeline, job->extent, job->draws, job->frameSlot, first, count);
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO END SECONDARY COMMAND BUFFER ON THREAD %u\n", worker->index);
+        return 1;
+    }
+    return 0;
+}
+
+static void* recordWorkerMain(void* arg){
+    struct recordWorker* worker = arg;
+    struct recordPool* pool = worker->pool;
+    uint64_t seen = 0;
+    for(;;){
+        pthread_mutex_lock(&pool->mutex);
+        while(pool->generation == seen && !pool->quit) pthread_cond_wait(&pool->start, &pool->mutex);
+        if(pool->quit){
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        seen = pool->generation;
+        struct recordJob job = pool->job;
+        pthread_mutex_unlock(&pool->mutex);
+
+        worker->result = recordSecondary(worker, &job);
+
+        pthread_mutex_lock(&pool->mutex);
+        if(--pool->pending == 0) pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+// every thread owns a pool per frame in flight, so no pool is ever touched by two threads or reset while the gpu reads from it
+static inline int createRecordPool(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface, uint32_t threadCount, uint32_t frameCount, struct recordPool* pool){
+    struct QueueFamilyIndices indices;
+    if(findQueueFamilies(physicalDevice, &indices, surface)){
+        fprintf(stdout, "ERROR: FAILED TO FIND QUEUE FAMILIES FOR THE RECORDING THREADS\n");
+        return 1;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->device = device;
+    pool->threadCount = threadCount;
+    pool->frameCount = frameCount;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for(uint32_t t = 0; t < threadCount; t++){
+        struct recordWorker* worker = pool->workers + t;
+        worker->pool = pool;
+        worker->index = t;
+        for(uint32_t f = 0; f < frameCount; f++){
+            VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = indices.graphicsFamily
+            };
+            if(vkCreateCommandPool(device, &poolInfo, NULL, worker->commandPools + f) != VK_SUCCESS){
+                fprintf(stdout, "ERROR: COMMAND POOL CREATION FAILED FOR THREAD %u\n", t);
+                return 1;
+            }
+            VkCommandBufferAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = worker->commandPools[f],
+                .commandBufferCount = 1,
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY
+            };
+            if(vkAllocateCommandBuffers(device, &allocInfo, worker->secondary + f) != VK_SUCCESS){
+                fprintf(stdout, "ERROR: SECONDARY COMMAND BUFFER ALLOCATION FAILED FOR THREAD %u\n", t);
+                return 1;
+            }
+        }
+        if(pthread_create(&worker->thread, NULL, recordWorkerMain, worker)){
+            fprintf(stdout, "ERROR: FAILED TO START RECORDING THREAD %u\n", t);
+            pool->threadCount = t; // only join what was started
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// blocks until every thread has recorded its slice
+static inline int recordPoolRun(struct recordPool* pool, struct recordJob* job){
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = *job;
+    pool->pending = pool->threadCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    while(pool->pending) pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    for(uint32_t t = 0; t < pool->threadCount; t++) if(pool->workers[t].result) return 1;
+    return 0;
+}
+
+static inline void destroyRecordPool(struct recordPool* pool){
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    for(uint32_t t = 0; t < pool->threadCount; t++) pthread_join(pool->workers[t].thread, NULL);
+    for(uint32_t t = 0; t < MAX_RECORD_THREADS; t++){
+        for(uint32_t f = 0; f < pool->frameCount; f++){
+            if(pool->workers[t].commandPools[f] != VK_NULL_HANDLE) vkDestroyCommandPool(pool->device, pool->workers[t].commandPools[f], NULL);
+        }
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+}
+
+// core entry points on 1.3 devices, the extension and 1.2 otherwise since it needs create_renderpass2 and depth_stencil_resolve
+static inline int dynamicRenderingSupported(VkPhysicalDevice device){
+    uint32_t apiVersion = deviceApiVersion(device);
+    if(apiVersion < VK_API_VERSION_1_3 && (apiVersion < VK_API_VERSION_1_2 || !deviceExtensionSupported(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))) return 0;
+    VkPhysicalDeviceDynamicRenderingFeatures dynamic = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES};
+    VkPhysicalDeviceFeatures2 features2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &dynamic};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    return dynamic.dynamicRendering;
+}
+
+static inline int createDynamicRendering(VkDevice device, struct dynamicRendering* rendering){
+    rendering->begin = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRendering");
+    rendering->end = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRendering");
+    if(rendering->begin == NULL) rendering->begin = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+    if(rendering->end == NULL) rendering->end = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+    if(rendering->begin == NULL || rendering->end == NULL){
+        fprintf(stdout, "ERROR: DYNAMIC RENDERING FUNCTIONS NOT FOUND\n");
+        return 1;
+    }
+    return 0;
+}
+
+// a null renderPass renders dynamically, the layout change the render pass would do on load is then an explicit barrier
+static inline void recordBeginRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, struct dynamicRendering* rendering, VkImage image, VkImageView view, struct sChainImgInfo* imgInfo, uint32_t secondaries){
+    VkClearValue clearVal = {
+        .color = {.float32 = {0.0f, 0.0f, 0.0f, 1.0f}}
+    };
+    VkRect2D renderArea = {.offset = {0,0}, .extent = imgInfo->swapChainExtent };
+    if(renderPass != VK_NULL_HANDLE){
+        VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = renderPass,
+            .framebuffer = framebuffer,
+            .renderArea = renderArea,
+            .clearValueCount = 1,
+            .pClearValues = &clearVal
+        };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+    // same scope as the render pass's external dependency, the stage the acquire semaphore is waited on
+    VkImageMemoryBarrier toAttachment = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &toAttachment);
+    VkRenderingAttachmentInfo colorAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = clearVal
+    };
+    VkRenderingInfo renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0,
+        .renderArea = renderArea,
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachment
+    };
+    rendering->begin(commandBuffer, &renderingInfo);
+}
+
+static inline void recordEndRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass, struct dynamicRendering* rendering, VkImage image, struct sChainImgInfo* imgInfo){
+    if(renderPass != VK_NULL_HANDLE){
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+    rendering->end(commandBuffer);
+    // present or the offscreen readback layout, made visible by the semaphore or timeline the next user waits on
+    VkImageMemoryBarrier toFinal = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = imgInfo->finalLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &toFinal);
+}
+
+// frameBuffers is only read with a render pass, images and imageViews only without one
+static inline int recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkFramebuffer* frameBuffers, VkRenderPass renderPass, struct dynamicRendering* rendering, VkImage* images, VkImageView* imageViews,
+    struct sChainImgInfo* imgInfo, VkPipeline graphicsPipeline, struct drawList* draws, struct recordPool* recorder, struct gpuTimer* timer, uint32_t frameSlot){
+    struct gpuCuller* culler = draws->culler;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = 0,
+        .pInheritanceInfo = NULL
+    };
+
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo ) != VK_SUCCESS ){
+        fprintf(stdout, "ERROR: FAILED TO BEGIN RECORDING COMMAND BUFFER\n");
+        return 1;
+    }
+    gpuTimerReset(timer, commandBuffer, frameSlot);
+    uint32_t frameScope = gpuTimerBegin(timer, commandBuffer, frameSlot, "frame");
+    if(culler && culler->computeFamily != culler->graphicsFamily) recordCullingAcquire(commandBuffer, culler, frameSlot);
+    else if(culler){
+        uint32_t cullScope = gpuTimerBegin(timer, commandBuffer, frameSlot, "cull");
+        recordCulling(commandBuffer, culler, frameSlot);
+        gpuTimerEnd(timer, commandBuffer, frameSlot, cullScope);
+    }
+
+    uint32_t passScope = gpuTimerBegin(timer, commandBuffer, frameSlot, "renderpass");
+    uint32_t drawCount = draws->instances->drawCount[frameSlot];
+    VkFramebuffer framebuffer = renderPass != VK_NULL_HANDLE ? frameBuffers[imageIndex] : VK_NULL_HANDLE;
+    // indirect draws are a handful of commands, only a cpu side draw list is worth splitting across threads
+    // without a pipeline yet the pass only clears
+    uint32_t secondaries = recorder && !culler && graphicsPipeline != VK_NULL_HANDLE;
+    recordBeginRendering(commandBuffer, renderPass, framebuffer, rendering, images[imageIndex], imageViews[imageIndex], imgInfo, secondaries);
+    if(secondaries){
+        struct recordJob job = {
+            .renderPass = renderPass,
+            .framebuffer = framebuffer,
+            .colorFormat = imgInfo->swapChainImageFormat,
+            .extent = imgInfo->swapChainExtent,
+            .pipeline = graphicsPipeline,
+            .draws = draws,
+            .frameSlot = frameSlot,
+            .drawCount = drawCount
+        };
+        if(recordPoolRun(recorder, &job)) return 1;
+        VkCommandBuffer buffers[MAX_RECORD_THREADS];
+        for(uint32_t t = 0; t < recorder->threadCount; t++) buffers[t] = recorder->workers[t].secondary[frameSlot];
+        vkCmdExecuteCommands(commandBuffer, recorder->threadCount, buffers);
+    } else if(graphicsPipeline != VK_NULL_HANDLE) recordDraws(commandBuffer, graphicsPipeline, imgInfo->swapChainExtent, draws, frameSlot, 0, drawCount);
+
+    //render Pass body end
+    recordEndRendering(commandBuffer, renderPass, rendering, images[imageIndex], imgInfo);
+    gpuTimerEnd(timer, commandBuffer, frameSlot, passScope);
+    gpuTimerEnd(timer, commandBuffer, frameSlot, frameScope);
+
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO EMD COMMAND BUFFER DURING RECORD\n");
+        return 1;
+    }
+    return 0;
+}
+
+// binary semaphores the swapchain needs, frame completion is tracked by the graphics timeline
+static inline int createSyncObects(VkDevice device , VkSemaphore* imgAvailable, VkSemaphore* renderFinished){
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
 
-    VkClearValue clearVal = {
-        .color = {.float32 = {0.0f, 0.0f, 0.0f, 1.0f}}
+    if(
+        (vkCreateSemaphore(device, &semaphoreInfo, NULL, imgAvailable) != VK_SUCCESS) |
+        (vkCreateSemaphore(device, &semaphoreInfo, NULL, renderFinished) != VK_SUCCESS)
+    ){
+        fprintf(stdout, "ERROR: FAILED TO CRETE SYNCRONIZATION OBJECTS\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline int createCommandAllocator(VkDevice device, uint32_t family, struct commandAllocator* commands){
+    memset(commands, 0, sizeof(*commands));
+    // no RESET_COMMAND_BUFFER_BIT, buffers are only ever reset together with the pool
+    return createFamilyCommandPool(device, family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &commands->pool);
+}
+
+static inline void commandAllocatorReset(VkDevice device, struct commandAllocator* commands){
+    vkResetCommandPool(device, commands->pool, 0);
+    commands->used = 0;
+    commands->allocatedThisFrame = 0;
+    commands->recycledThisFrame = 0;
+}
+
+// primary buffers only, allocates when every buffer from earlier frames is already in use this frame
+static inline int commandAllocatorGet(VkDevice device, struct commandAllocator* commands, VkCommandBuffer* commandBuffer){
+    if(commands->used < commands->capacity){
+        *commandBuffer = commands->buffers[commands->used++];
+        commands->recycledThisFrame++;
+        commands->recycledTotal++;
+        return 0;
+    }
+    VkCommandBuffer* buffers = realloc(commands->buffers, sizeof(VkCommandBuffer) * (commands->capacity + 1));
+    if(buffers == NULL){
+        fprintf(stdout, "ERROR: COMMAND BUFFER LIST REALLOC FAILED\n");
+        return 1;
+    }
+    commands->buffers = buffers;
+    if(createCommandBuffer(device, commands->pool, buffers + commands->capacity)) return 1;
+    *commandBuffer = buffers[commands->capacity++];
+    commands->used++;
+    commands->allocatedThisFrame++;
+    commands->allocatedTotal++;
+    return 0;
+}
+
+// command buffers are freed together with their pool
+static inline void destroyCommandAllocator(VkDevice device, struct commandAllocator* commands){
+    vkDestroyCommandPool(device, commands->pool, NULL);
+    free(commands->buffers);
+}
+
+static inline int createCommandCache(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR* surface, uint32_t imageCount, uint32_t frameCount, struct commandCache* cache){
+    memset(cache, 0, sizeof(*cache));
+    cache->imageCount = imageCount;
+    cache->frameCount = frameCount;
+    if((cache->entries = calloc(imageCount * frameCount, sizeof(struct commandCacheEntry))) == NULL){
+        fprintf(stdout, "ERROR: COMMAND CACHE CALLOC FAILED\n");
+        return 1;
+    }
+    // misses are rare, so the per-buffer reset flag is worth it to re-record an entry in place
+    return createCommandPool(device, physicalDevice, surface, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, &cache->pool);
+}
+
+static inline void commandCacheMakeKey(struct commandCache* cache, VkImageView attachment, VkRenderPass renderPass, VkPipeline pipeline, VkExtent2D extent, uint32_t drawCount, struct commandCacheKey* key){
+    memset(key, 0, sizeof(*key)); // padding takes part in the comparison
+    key->attachment = attachment;
+    key->renderPass = renderPass;
+    key->pipeline = pipeline;
+    key->extent = extent;
+    key->drawCount = drawCount;
+    key->sceneVersion = cache->sceneVersion;
+}
+
+// on a miss the entry's buffer is ready to be recorded and the key already stored
+static inline int commandCacheLookup(VkDevice device, struct commandCache* cache, uint32_t imageIndex, uint32_t frameSlot, struct commandCacheKey* key, struct commandCacheEntry** entry, uint32_t* hit){
+    struct commandCacheEntry* e = cache->entries + imageIndex * cache->frameCount + frameSlot;
+    *entry = e;
+    *hit = e->commandBuffer != VK_NULL_HANDLE && memcmp(&e->key, key, sizeof(*key)) == 0;
+    if(*hit){
+        cache->hits++;
+        return 0;
+    }
+    cache->misses++;
+    if(e->commandBuffer == VK_NULL_HANDLE && createCommandBuffer(device, cache->pool, &e->commandBuffer)) return 1;
+    e->key = *key;
+    return 0;
+}
+
+// for scene changes the key cannot see, everything is re-recorded on next use
+static inline void commandCacheInvalidate(struct commandCache* cache){
+    cache->sceneVersion++;
+}
+
+// framebuffer handles of a new swapchain can repeat old values, so every entry is re-recorded regardless
+static inline int commandCacheResize(VkDevice device, struct commandCache* cache, uint32_t imageCount){
+    commandCacheInvalidate(cache);
+    if(imageCount == cache->imageCount) return 0;
+    for(uint32_t i = 0; i < cache->imageCount * cache->frameCount; i++)
+        if(cache->entries[i].commandBuffer != VK_NULL_HANDLE) vkFreeCommandBuffers(device, cache->pool, 1, &cache->entries[i].commandBuffer);
+    free(cache->entries);
+    cache->imageCount = imageCount;
+    if((cache->entries = calloc(imageCount * cache->frameCount, sizeof(struct commandCacheEntry))) == NULL){
+        fprintf(stdout, "ERROR: COMMAND CACHE CALLOC FAILED\n");
+        return 1;
+    }
+    return 0;
+}
+
+static inline void destroyCommandCache(VkDevice device, struct commandCache* cache){
+    vkDestroyCommandPool(device, cache->pool, NULL);
+    free(cache->entries);
+}
+
+static void* presentLatencyMain(void* arg){
+    struct presentLatency* latency = arg;
+    pthread_mutex_lock(&latency->mutex);
+    for(;;){
+        while(latency->waitedId >= latency->queuedId && !latency->quit) pthread_cond_wait(&latency->wake, &latency->mutex);
+        if(latency->quit) break;
+        uint64_t id = latency->waitedId + 1;
+        pthread_mutex_unlock(&latency->mutex);
+
+        // bounded so a swapchain rebuild never waits on a present that will not happen
+        pthread_mutex_lock(&latency->waitLock);
+        VkResult res = latency->waitForPresent(latency->device, latency->swapChain, id, PRESENT_WAIT_SLICE_NS);
+        pthread_mutex_unlock(&latency->waitLock);
+        double now = timeMs();
+
+        pthread_mutex_lock(&latency->mutex);
+        // ids given up by a swapchain rebuild are already behind waitedId
+        if(res == VK_TIMEOUT || id <= latency->waitedId) continue;
+        latency->waitedId = id;
+        if(res != VK_SUCCESS) continue;
+        latency->lastPresentMs = now;
+        if(id < latency->measureFrom) continue;
+        if(latency->sampleCount == latency->sampleCapacity){
+            uint64_t capacity = latency->sampleCapacity ? latency->sampleCapacity * 2 : 1024;
+            double* samples = realloc(latency->samples, sizeof(double) * capacity);
+            if(samples == NULL){
+                fprintf(stdout, "ERROR: LATENCY SAMPLE REALLOC FAILED\n");
+                continue;
+            }
+            latency->samples = samples;
+            latency->sampleCapacity = capacity;
+        }
+        latency->samples[latency->sampleCount++] = now - latency->sampleMs[id % PRESENT_HISTORY];
+    }
+    pthread_mutex_unlock(&latency->mutex);
+    return NULL;
+}
+
+// leaves the latency disabled rather than failing when the device cannot wait for presents
+static inline int createPresentLatency(VkDevice device, VkSwapchainKHR swapChain, uint32_t enabled, struct presentLatency* latency){
+    memset(latency, 0, sizeof(*latency));
+    if(!enabled) return 0;
+    latency->waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+    if(latency->waitForPresent == NULL){
+        fprintf(stdout, "WARNING: vkWaitForPresentKHR NOT FOUND, PRESENT LATENCY NOT MEASURED\n");
+        return 0;
+    }
+    latency->device = device;
+    latency->swapChain = swapChain;
+    latency->measureFrom = UINT64_MAX; // until the warmup is over
+    pthread_mutex_init(&latency->waitLock, NULL);
+    pthread_mutex_init(&latency->mutex, NULL);
+    pthread_cond_init(&latency->wake, NULL);
+    if(pthread_create(&latency->thread, NULL, presentLatencyMain, latency)){
+        fprintf(stdout, "ERROR: FAILED TO START THE PRESENT WAIT THREAD\n");
+        return 1;
+    }
+    return 0;
+}
+
+// id to chain into the present through VkPresentIdKHR, 0 leaves the frame unmeasured
+static inline uint64_t presentLatencyBegin(struct presentLatency* latency, double sampleMs){
+    if(latency->waitForPresent == NULL) return 0;
+    uint64_t id = 0;
+    pthread_mutex_lock(&latency->mutex);
+    if(latency->presentId - latency->waitedId < PRESENT_HISTORY){
+        id = ++latency->presentId;
+        latency->sampleMs[id % PRESENT_HISTORY] = sampleMs;
+    }
+    pthread_mutex_unlock(&latency->mutex);
+    return id;
+}
+
+// frames presented from now on are kept, called when the warmup ends
+static inline void presentLatencyMeasureFrom(struct presentLatency* latency){
+    if(latency->waitForPresent == NULL) return;
+    pthread_mutex_lock(&latency->mutex);
+    latency->measureFrom = latency->presentId + 1;
+    pthread_mutex_unlock(&latency->mutex);
+}
+
+// when the newest image reached the display, 0 if that is unknown
+static inline double presentLatencyLastPresent(struct presentLatency* latency){
+    if(latency->waitForPresent == NULL) return 0.0;
+    pthread_mutex_lock(&latency->mutex);
+    double presentMs = latency->lastPresentMs;
+    pthread_mutex_unlock(&latency->mutex);
+    return presentMs;
+}
+
+// wakes the thread for an id that went through vkQueuePresentKHR, whatever the present returned
+static inline void presentLatencyQueued(struct presentLatency* latency, uint64_t id){
+    if(latency->waitForPresent == NULL || id == 0) return;
+    pthread_mutex_lock(&latency->mutex);
+    latency->queuedId = id;
+    pthread_cond_signal(&latency->wake);
+    pthread_mutex_unlock(&latency->mutex);
+}
+
+// keeps the thread's vkWaitForPresentKHR off the swapchain while the caller uses it, a wait holds it for at most PRESENT_WAIT_SLICE_NS
+static inline void presentLatencyLock(struct presentLatency* latency){
+    if(latency->waitForPresent) pthread_mutex_lock(&latency->waitLock);
+}
+
+static inline void presentLatencyUnlock(struct presentLatency* latency){
+    if(latency->waitForPresent) pthread_mutex_unlock(&latency->waitLock);
+}
+
+// called under presentLatencyLock, outstanding ids belong to the old swapchain and are given up, it can be destroyed once the lock is released
+static inline void presentLatencySetSwapChain(struct presentLatency* latency, VkSwapchainKHR swapChain){
+    if(latency->waitForPresent == NULL) return;
+    pthread_mutex_lock(&latency->mutex);
+    latency->waitedId = latency->presentId;
+    pthread_mutex_unlock(&latency->mutex);
+    latency->swapChain = swapChain;
+}
+
+// the samples outlive the thread and are freed by the caller
+static inline void destroyPresentLatency(struct presentLatency* latency){
+    if(latency->waitForPresent == NULL) return;
+    pthread_mutex_lock(&latency->mutex);
+    latency->quit = 1;
+    pthread_cond_signal(&latency->wake);
+    pthread_mutex_unlock(&latency->mutex);
+    pthread_join(latency->thread, NULL);
+    pthread_cond_destroy(&latency->wake);
+    pthread_mutex_destroy(&latency->mutex);
+    pthread_mutex_destroy(&latency->waitLock);
+    latency->waitForPresent = NULL;
+}
+
+static inline void createFramePacer(GLFWwindow* window, struct framePacer* pacer){
+    memset(pacer, 0, sizeof(*pacer));
+    GLFWmonitor* monitor = glfwGetWindowMonitor(window); // only set for fullscreen windows
+    if(monitor == NULL) monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+    pacer->refreshMs = 1000.0 / ((mode && mode->refreshRate > 0) ? mode->refreshRate : DEFAULT_REFRESH_RATE);
+    pacer->vblankMs = timeMs();
+}
+
+// sleeps until the latest start that still lets the frame make the earliest vblank it can reach
+static inline void framePacerWait(struct framePacer* pacer, struct presentLatency* latency){
+    // present waits return at the flip, which keeps the schedule from drifting away from the display
+    double presentMs = presentLatencyLastPresent(latency);
+    if(presentMs > pacer->vblankMs) pacer->vblankMs = presentMs;
+    double ready = timeMs() + pacer->workMs + PACING_MARGIN_MS;
+    double target = pacer->vblankMs + ceil((ready - pacer->vblankMs) / pacer->refreshMs) * pacer->refreshMs;
+    // a second frame for the same vblank would only queue up behind the first
+    if(target < pacer->targetMs + pacer->refreshMs * 0.5) target = pacer->targetMs + pacer->refreshMs;
+    pacer->targetMs = target;
+    sleepUntilMs(target - pacer->workMs - PACING_MARGIN_MS);
+}
+
+static inline void framePacerUpdate(struct framePacer* pacer, double workMs){
+    if(workMs > pacer->workMs) pacer->workMs = workMs; // a missed vblank costs a whole refresh, so spikes count at once
+    else pacer->workMs = pacer->workMs * 0.95 + workMs * 0.05;
+}
+
+static inline int createFrameRing(VkDevice device, struct qHandles* queues, struct gpuAllocator* allocator, VkDeviceSize arenaSize, struct frameData* frames, uint32_t frameCount){
+    for(uint32_t i = 0; i < frameCount; i++){
+        if(createCommandAllocator(device, queues->graphicsFamily, &frames[i].commands)) return 1;
+        if(createCommandAllocator(device, queues->computeFamily, &frames[i].computeCommands)) return 1;
+        if(createSyncObects(device, &frames[i].imgAvailable, &frames[i].renderFinished)) return 1;
+        frames[i].submitValue = 0;
+        frames[i].frameNumber = 0;
+        VkBufferUsageFlags arenaUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        if(createLinearArena(allocator, arenaSize, arenaUsage, &frames[i].arena)) return 1;
+        VkDescriptorPoolSize poolSizes[2] = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, FRAME_DESCRIPTOR_BUFFERS},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FRAME_DESCRIPTOR_BUFFERS}
+        };
+        VkDescriptorPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = FRAME_DESCRIPTOR_SETS,
+            .poolSizeCount = 2,
+            .pPoolSizes = poolSizes
+        };
+        if(vkCreateDescriptorPool(device, &poolInfo, NULL, &frames[i].descriptorPool) != VK_SUCCESS){
+            fprintf(stdout, "ERROR: FRAME DESCRIPTOR POOL CREATION FAILED\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void destroyFrameRing(VkDevice device, struct gpuAllocator* allocator, struct frameData* frames, uint32_t frameCount){
+    for(uint32_t i = 0; i < frameCount; i++){
+        destroyCommandAllocator(device, &frames[i].commands);
+        destroyCommandAllocator(device, &frames[i].computeCommands);
+        vkDestroySemaphore(device, frames[i].imgAvailable, NULL);
+        vkDestroySemaphore(device, frames[i].renderFinished, NULL);
+        destroyBuffer(allocator, frames[i].arena.buffer, &frames[i].arena.allocation);
+        vkDestroyDescriptorPool(device, frames[i].descriptorPool, NULL);
+    }
+}
+
+// bindingFlags may be NULL, the same bindings always give back the same layout
+static inline int descriptorLayoutGet(struct descriptorCache* cache, const VkDescriptorSetLayoutBinding* bindings, const VkDescriptorBindingFlags* bindingFlags, uint32_t bindingCount, VkDescriptorSetLayoutCreateFlags flags, VkDescriptorSetLayout* layout){
+    if(bindingCount > DESCRIPTOR_MAX_BINDINGS){
+        fprintf(stdout, "ERROR: DESCRIPTOR SET LAYOUTS HAVE AT MOST %d BINDINGS\n", DESCRIPTOR_MAX_BINDINGS);
+        return 1;
+    }
+    struct descriptorLayoutEntry key;
+    memset(&key, 0, sizeof(key)); // padding and unused bindings take part in the comparison
+    key.flags = flags;
+    key.bindingCount = bindingCount;
+    if(bindingCount) memcpy(key.bindings, bindings, sizeof(VkDescriptorSetLayoutBinding) * bindingCount);
+    if(bindingFlags) memcpy(key.bindingFlags, bindingFlags, sizeof(VkDescriptorBindingFlags) * bindingCount);
+    for(uint32_t i = 0; i < cache->count; i++){
+        if(memcmp(cache->entries + i, &key, offsetof(struct descriptorLayoutEntry, layout)) == 0){
+            cache->hits++;
+            *layout = cache->entries[i].layout;
+            return 0;
+        }
+    }
+    if(cache->count == DESCRIPTOR_MAX_LAYOUTS){
+        fprintf(stdout, "ERROR: DESCRIPTOR SET LAYOUT CACHE FULL\n");
+        return 1;
+    }
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = bindingCount,
+        .pBindingFlags = key.bindingFlags
     };
-    VkRenderPassBeginInfo renderPassBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = renderPass,
-        .framebuffer = frameBuffers[imageIndex],
-        .renderArea = {.offset = {0,0}, .extent = imgInfo->swapChainExtent },
-        .clearValueCount = 1,
-        .pClearValues = &clearVal
+    VkDescriptorSetLayoutCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = bindingFlags ? &flagsInfo : NULL,
+        .flags = flags,
+        .bindingCount = bindingCount,
+        .pBindings = key.bindings
     };
+    if(vkCreateDescriptorSetLayout(cache->device, &createInfo, NULL, &key.layout) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: DESCRIPTOR SET LAYOUT CREATION FAILED\n");
+        return 1;
+    }
+    cache->entries[cache->count++] = key;
+    *layout = key.layout;
+    return 0;
+}
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
-    // render Pass body begin
+static inline void destroyDescriptorCache(struct descriptorCache* cache){
+    for(uint32_t i = 0; i < cache->count; i++) vkDestroyDescriptorSetLayout(cache->device, cache->entries[i].layout, NULL);
+    cache->count = 0;
+}
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline );
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float)(imgInfo->swapChainExtent.width),
-        .height = (float)(imgInfo->swapChainExtent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
+// asked for once by the pipeline layout and again by the sets, the second time comes from the cache
+static inline int frameDescriptorLayout(struct descriptorCache* cache, uint32_t mode, VkDescriptorSetLayout* layout){
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = mode == DESCRIPTOR_MODE_DYNAMIC ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
     };
-    vkCmdSetViewport(commandBuffer,0,1,&viewport);
+    return descriptorLayoutGet(cache, &binding, NULL, 1, 0, layout);
+}
 
-    VkRect2D scissor = {
-        .extent = imgInfo->swapChainExtent,
-        .offset = {0, 0}
+// with DESCRIPTOR_MODE_DYNAMIC each slot's set points at the start of its arena once and for all, the uniforms are then found through the dynamic offset
+static inline int createFrameDescriptors(struct descriptorCache* cache, VkPhysicalDeviceProperties* props, uint32_t mode, VkDeviceSize range, struct frameData* frames, uint32_t frameCount, struct frameDescriptors* descriptors){
+    VkDevice device = cache->device;
+    memset(descriptors, 0, sizeof(*descriptors));
+    descriptors->mode = mode;
+    descriptors->alignment = props->limits.minUniformBufferOffsetAlignment;
+    if(frameDescriptorLayout(cache, mode, &descriptors->layout)) return 1;
+    if(mode != DESCRIPTOR_MODE_DYNAMIC) return 0;
+    VkDescriptorPoolSize poolSize = {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = frameCount};
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = frameCount,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
     };
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    if(vkCreateDescriptorPool(device, &poolInfo, NULL, &descriptors->pool) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FRAME DESCRIPTOR POOL CREATION FAILED\n");
+        return 1;
+    }
+    VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT];
+    for(uint32_t i = 0; i < frameCount; i++) setLayouts[i] = descriptors->layout;
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptors->pool,
+        .descriptorSetCount = frameCount,
+        .pSetLayouts = setLayouts
+    };
+    if(vkAllocateDescriptorSets(device, &setInfo, descriptors->sets) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FRAME DESCRIPTOR SET ALLOCATION FAILED\n");
+        return 1;
+    }
+    for(uint32_t i = 0; i < frameCount; i++){
+        VkDescriptorBufferInfo bufferInfo = {frames[i].arena.buffer, 0, range};
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptors->sets[i],
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .pBufferInfo = &bufferInfo
+        };
+        vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    }
+    return 0;
+}
+
+// only valid until the frame's pool is reset, which happens once its timeline value is reached
+static inline int frameDescriptorAlloc(VkDevice device, struct frameData* frame, VkDescriptorSetLayout layout, VkDescriptorSet* set){
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = frame->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout
+    };
+    if(vkAllocateDescriptorSets(device, &setInfo, set) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FRAME DESCRIPTOR POOL EXHAUSTED\n");
+        return 1;
+    }
+    return 0;
+}
+
+// the uniforms go into the frame's arena, only DESCRIPTOR_MODE_UPDATE touches a descriptor to find them
+static inline int frameDescriptorsUpdate(VkDevice device, struct frameDescriptors* descriptors, struct frameData* frame, uint32_t frameSlot, const struct frameUniforms* uniforms){
+    VkDeviceSize offset;
+    void* data;
+    if(arenaAlloc(&frame->arena, sizeof(*uniforms), descriptors->alignment, &offset, &data)){
+        fprintf(stdout, "ERROR: FRAME ARENA FULL\n");
+        return 1;
+    }
+    memcpy(data, uniforms, sizeof(*uniforms));
+    if(descriptors->mode == DESCRIPTOR_MODE_DYNAMIC){
+        descriptors->offsets[frameSlot] = (uint32_t)offset;
+        return 0;
+    }
+    if(frameDescriptorAlloc(device, frame, descriptors->layout, descriptors->sets + frameSlot)) return 1;
+    VkDescriptorBufferInfo bufferInfo = {frame->arena.buffer, offset, sizeof(*uniforms)};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptors->sets[frameSlot],
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .pBufferInfo = &bufferInfo
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    descriptors->setWrites++;
+    return 0;
+}
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+static inline void destroyFrameDescriptors(VkDevice device, struct frameDescriptors* descriptors){
+    if(descriptors->pool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, descriptors->pool, NULL);
+}
 
-    //render Pass body end
-    vkCmdEndRenderPass(commandBuffer);
+// distance between two draws' drawConstants in the arena, dynamic offsets must be multiples of alignment
+static inline VkDeviceSize drawUniformStride(VkDeviceSize alignment){
+    return (sizeof(struct drawConstants) + alignment - 1) / alignment * alignment;
+}
 
-    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
-        fprintf(stdout, "ERROR: FAILED TO EMD COMMAND BUFFER DURING RECORD\n");
+// the uniform ring fallback of push constants, every draw of the frame gets its block in one arena allocation
+static inline int writeDrawUniforms(struct instanceRing* ring, struct frameDescriptors* drawUniforms, struct frameData* frame, uint32_t frameSlot){
+    VkDeviceSize stride = drawUniformStride(drawUniforms->alignment);
+    uint32_t count = ring->drawCount[frameSlot];
+    VkDeviceSize offset;
+    void* data;
+    if(arenaAlloc(&frame->arena, stride * (count ? count : 1), drawUniforms->alignment, &offset, &data)){
+        fprintf(stdout, "ERROR: FRAME ARENA FULL\n");
         return 1;
     }
+    for(uint32_t i = 0; i < count; i++){
+        struct instanceData* instance = ring->host + i;
+        *(struct drawConstants*)((char*)data + stride * i) = (struct drawConstants){
+            {instance->transform[0], instance->transform[1], instance->transform[2]}, i,
+            {instance->color[0], instance->color[1], instance->color[2], 1.0f}
+        };
+    }
+    drawUniforms->offsets[frameSlot] = (uint32_t)offset;
     return 0;
 }
 
-static inline int createSyncObects(VkDevice device , VkSemaphore* imgAvailable, VkSemaphore* renderFinished, VkFence* inFlight ){
-    VkFenceCreateInfo fenceInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
+static inline int descriptorIndexingSupported(VkPhysicalDevice device){
+    if(deviceApiVersion(device) < VK_API_VERSION_1_2 && !deviceExtensionSupported(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) return 0;
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    VkPhysicalDeviceFeatures2 features2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &indexing};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    return indexing.runtimeDescriptorArray && indexing.descriptorBindingPartiallyBound && indexing.shaderSampledImageArrayNonUniformIndexing &&
+        indexing.descriptorBindingSampledImageUpdateAfterBind && indexing.descriptorBindingStorageBufferUpdateAfterBind;
+}
+
+// binding 0 holds sampled images and binding 1 storage buffers, sized to the update after bind limits
+static inline int createBindlessTable(VkPhysicalDevice physicalDevice, struct descriptorCache* cache, struct bindlessTable* table){
+    VkDevice device = cache->device;
+    memset(table, 0, sizeof(*table));
+    VkPhysicalDeviceDescriptorIndexingProperties indexing = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+    VkPhysicalDeviceProperties2 props2 = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &indexing};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+    table->maxTextures = BINDLESS_MAX_TEXTURES;
+    if(table->maxTextures > indexing.maxPerStageDescriptorUpdateAfterBindSampledImages) table->maxTextures = indexing.maxPerStageDescriptorUpdateAfterBindSampledImages;
+    if(table->maxTextures > indexing.maxDescriptorSetUpdateAfterBindSampledImages) table->maxTextures = indexing.maxDescriptorSetUpdateAfterBindSampledImages;
+    table->maxBuffers = BINDLESS_MAX_BUFFERS;
+    if(table->maxBuffers > indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers) table->maxBuffers = indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers;
+    if(table->maxBuffers > indexing.maxDescriptorSetUpdateAfterBindStorageBuffers) table->maxBuffers = indexing.maxDescriptorSetUpdateAfterBindStorageBuffers;
+    // both arrays are visible to the same stages, so together they get what the per stage limit leaves after the other sets
+    if(indexing.maxPerStageUpdateAfterBindResources < BINDLESS_OTHER_RESOURCES + 2){
+        fprintf(stdout, "ERROR: maxPerStageUpdateAfterBindResources IS %u, TOO FEW FOR A BINDLESS TABLE\n", indexing.maxPerStageUpdateAfterBindResources);
+        return 1;
+    }
+    uint32_t budget = indexing.maxPerStageUpdateAfterBindResources - BINDLESS_OTHER_RESOURCES;
+    if((uint64_t)table->maxTextures + table->maxBuffers > budget){
+        // split evenly, an array needing less than half leaves the rest to the other
+        uint32_t half = budget / 2;
+        if(table->maxTextures > half && table->maxBuffers > half){
+            table->maxTextures = budget - half;
+            table->maxBuffers = half;
+        }else if(table->maxTextures > half) table->maxTextures = budget - table->maxBuffers;
+        else table->maxBuffers = budget - table->maxTextures;
+    }
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, table->maxTextures, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, table->maxBuffers, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, NULL}
+    };
+    // slots nothing was added to are never read, and adding one does not disturb frames that already bound the set
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+    };
+    if(descriptorLayoutGet(cache, bindings, bindingFlags, 2, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, &table->layout)) return 1;
+    VkDescriptorPoolSize poolSizes[2] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, table->maxTextures},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, table->maxBuffers}
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
     };
+    if(vkCreateDescriptorPool(device, &poolInfo, NULL, &table->pool) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: BINDLESS DESCRIPTOR POOL CREATION FAILED\n");
+        return 1;
+    }
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = table->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &table->layout
+    };
+    if(vkAllocateDescriptorSets(device, &setInfo, &table->set) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: BINDLESS DESCRIPTOR SET ALLOCATION FAILED\n");
+        return 1;
+    }
+    return 0;
+}
 
-    VkSemaphoreCreateInfo semaphoreInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+// returns the index shaders find the buffer at in binding 1, UINT32_MAX once the table is full
+static inline uint32_t bindlessAddBuffer(VkDevice device, struct bindlessTable* table, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range){
+    if(table->bufferCount == table->maxBuffers){
+        fprintf(stdout, "ERROR: BINDLESS TABLE HOLDS AT MOST %u BUFFERS\n", table->maxBuffers);
+        return UINT32_MAX;
+    }
+    VkDescriptorBufferInfo bufferInfo = {buffer, offset, range};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = table->set,
+        .dstBinding = 1,
+        .dstArrayElement = table->bufferCount,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &bufferInfo
     };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    return table->bufferCount++;
+}
 
-    if(
-        (vkCreateSemaphore(device, &semaphoreInfo, NULL, imgAvailable) != VK_SUCCESS) |
-        (vkCreateSemaphore(device, &semaphoreInfo, NULL, renderFinished) != VK_SUCCESS) |
-        (vkCreateFence(device, &fenceInfo, NULL, inFlight) != VK_SUCCESS)
-    ){
-        fprintf(stdout, "ERROR: FAILED TO CRETE SYNCRONIZATION OBJECTS\n");
+// the view must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL whenever a shader reads it, index into binding 0
+static inline uint32_t bindlessAddTexture(VkDevice device, struct bindlessTable* table, VkImageView view){
+    if(table->textureCount == table->maxTextures){
+        fprintf(stdout, "ERROR: BINDLESS TABLE HOLDS AT MOST %u TEXTURES\n", table->maxTextures);
+        return UINT32_MAX;
+    }
+    VkDescriptorImageInfo imageInfo = {VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = table->set,
+        .dstBinding = 0,
+        .dstArrayElement = table->textureCount,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &imageInfo
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    return table->textureCount++;
+}
+
+static inline void destroyBindlessTable(VkDevice device, struct bindlessTable* table){
+    vkDestroyDescriptorPool(device, table->pool, NULL);
+}
+
+static inline int createGpuTimer(VkDevice device, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* props, VkSurfaceKHR* surface, uint32_t frameCount, struct gpuTimer* timer){
+    memset(timer, 0, sizeof(*timer));
+    struct QueueFamilyIndices indices;
+    if(findQueueFamilies(physicalDevice, &indices, surface)) return 1;
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties queueFamilyProperties[queueFamilyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties);
+    uint32_t validBits = queueFamilyProperties[indices.graphicsFamily].timestampValidBits;
+    if(!validBits || props->limits.timestampPeriod == 0.0f){
+        fprintf(stdout, "WARNING: GPU TIMESTAMPS NOT SUPPORTED ON THE GRAPHICS QUEUE\n");
+        return 0;
+    }
+    timer->validMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+    timer->msPerTick = props->limits.timestampPeriod / 1000000.0;
+
+    VkQueryPoolCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = frameCount * MAX_TIMESTAMP_SCOPES * 2
+    };
+    if(vkCreateQueryPool(device, &createInfo, NULL, &timer->queryPool) != VK_SUCCESS){
+        fprintf(stdout, "ERROR: TIMESTAMP QUERY POOL CREATION FAILED\n");
+        return 1;
+    }
+    return 0;
+}
+
+// must be recorded outside of a render pass before any scope of the frame
+static inline void gpuTimerReset(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot){
+    if(timer == NULL || timer->queryPool == VK_NULL_HANDLE) return;
+    vkCmdResetQueryPool(commandBuffer, timer->queryPool, frameSlot * MAX_TIMESTAMP_SCOPES * 2, MAX_TIMESTAMP_SCOPES * 2);
+    timer->scopeCount[frameSlot] = 0;
+}
+
+// returns the scope handle for gpuTimerEnd, scopes past MAX_TIMESTAMP_SCOPES are silently dropped
+static inline uint32_t gpuTimerBegin(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot, const char* name){
+    if(timer == NULL || timer->queryPool == VK_NULL_HANDLE || timer->scopeCount[frameSlot] == MAX_TIMESTAMP_SCOPES) return MAX_TIMESTAMP_SCOPES;
+    uint32_t scope = timer->scopeCount[frameSlot]++;
+    timer->scopeNames[frameSlot][scope] = name;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer->queryPool, (frameSlot * MAX_TIMESTAMP_SCOPES + scope) * 2);
+    return scope;
+}
+
+static inline void gpuTimerEnd(struct gpuTimer* timer, VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope){
+    if(timer == NULL || timer->queryPool == VK_NULL_HANDLE || scope >= MAX_TIMESTAMP_SCOPES) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->queryPool, (frameSlot * MAX_TIMESTAMP_SCOPES + scope) * 2 + 1);
+}
+
+// call after the slot's timeline value is reached, the queries are then available and this never blocks
+static inline int gpuTimerCollect(VkDevice device, struct gpuTimer* timer, uint32_t frameSlot){
+    uint32_t scopeCount = timer->scopeCount[frameSlot];
+    if(timer->queryPool == VK_NULL_HANDLE || !scopeCount) return 0;
+    uint64_t ticks[MAX_TIMESTAMP_SCOPES * 2];
+    VkResult res = vkGetQueryPoolResults(device, timer->queryPool, frameSlot * MAX_TIMESTAMP_SCOPES * 2, scopeCount * 2,
+        sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if(res == VK_NOT_READY) return 0;
+    if(res != VK_SUCCESS){
+        fprintf(stdout, "ERROR: FAILED TO READ TIMESTAMP QUERIES\n");
         return 1;
     }
+    for(uint32_t i = 0; i < scopeCount; i++){
+        timer->resultNames[i] = timer->scopeNames[frameSlot][i];
+        timer->resultMs[i] = ((ticks[i * 2 + 1] - ticks[i * 2]) & timer->validMask) * timer->msPerTick;
+    }
+    timer->resultCount = scopeCount;
+    return 0;
+}
+
+// 0 when the scope was not written by the last completed frame
+static inline double gpuTimerResult(struct gpuTimer* timer, const char* name){
+    for(uint32_t i = 0; i < timer->resultCount; i++){
+        if(strcmp(timer->resultNames[i], name) == 0) return timer->resultMs[i];
+    }
+    return 0.0;
+}
+
+static inline double timeMs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static inline void sleepUntilMs(double deadline){
+    if(deadline <= timeMs()) return;
+    struct timespec ts = {(time_t)(deadline / 1000.0), (long)(fmod(deadline, 1000.0) * 1000000.0)};
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+static inline int benchRecord(struct benchTimings* bench, const double* phases){
+    if(bench->count == bench->capacity){
+        uint64_t capacity = bench->capacity ? bench->capacity * 2 : 1024;
+        for(int i = 0; i < PHASE_COUNT; i++){
+            double* samples = realloc(bench->samples[i], sizeof(double) * capacity);
+            if(samples == NULL){
+                fprintf(stdout, "ERROR: BENCHMARK SAMPLE REALLOC FAILED\n");
+                return 1;
+            }
+            bench->samples[i] = samples;
+        }
+        bench->capacity = capacity;
+    }
+    for(int i = 0; i < PHASE_COUNT; i++) bench->samples[i][bench->count] = phases[i];
+    if(phases[PHASE_GPU] > phases[PHASE_FRAME] - phases[PHASE_WAIT] - phases[PHASE_PACE]) bench->gpuBound++;
+    bench->count++;
+    return 0;
+}
+
+static int compareDouble(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of an already sorted array
+static inline double percentile(const double* sorted, uint64_t count, double p){
+    uint64_t rank = (uint64_t)(p / 100.0 * count + 0.999999);
+    if(rank < 1) rank = 1;
+    if(rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// sorts the samples in place into min, mean, p50, p95, p99, max
+static inline void summarizeSamples(double* samples, uint64_t count, double* stats){
+    qsort(samples, count, sizeof(double), compareDouble);
+    double sum = 0.0;
+    for(uint64_t j = 0; j < count; j++) sum += samples[j];
+    stats[0] = samples[0];
+    stats[1] = sum / count;
+    stats[2] = percentile(samples, count, 50.0);
+    stats[3] = percentile(samples, count, 95.0);
+    stats[4] = percentile(samples, count, 99.0);
+    stats[5] = samples[count - 1];
+}
+
+// elapsed is the wall time of the measured frames, used for frames per second
+static inline void benchReport(struct benchTimings* bench, double elapsed, struct appOptions* options){
+    if(!bench->count){
+        fprintf(stdout, "WARNING: NO FRAMES MEASURED, INCREASE --frames OR --duration\n");
+        return;
+    }
+    // min, mean, p50, p95, p99, max
+    double stats[PHASE_COUNT][6];
+    for(int i = 0; i < PHASE_COUNT; i++) summarizeSamples(bench->samples[i], bench->count, stats[i]);
+    double latency[6] = {0};
+    if(bench->latencyCount) summarizeSamples(bench->latency, bench->latencyCount, latency);
+    double fps = bench->count / (elapsed / 1000.0);
+
+    fprintf(stdout, "Benchmark: %llu frames in %.1f ms, %.1f fps (%s, %u frames in flight, %u instances, %u recording threads, %s%s)\n",
+        (unsigned long long)bench->count, elapsed, fps, options->headless ? "headless" : "windowed", options->framesInFlight, options->instanceCount,
+        options->recordThreads, options->headless ? "no present" : presentModeName(options->presentMode), options->framePacing ? " paced" : "");
+    fprintf(stdout, "%-8s %10s %10s %10s %10s %10s %10s\n", "ms", "min", "mean", "p50", "p95", "p99", "max");
+    for(int i = 0; i < PHASE_COUNT; i++){
+        fprintf(stdout, "%-8s %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f\n", phaseNames[i],
+            stats[i][0], stats[i][1], stats[i][2], stats[i][3], stats[i][4], stats[i][5]);
+    }
+    // input sampling to the flip, only known with VK_KHR_present_wait
+    if(bench->latencyCount) fprintf(stdout, "%-8s %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f\n", "latency",
+        latency[0], latency[1], latency[2], latency[3], latency[4], latency[5]);
+    fprintf(stdout, "GPU bound frames: %llu of %llu (%.1f%%)\n", (unsigned long long)bench->gpuBound,
+        (unsigned long long)bench->count, 100.0 * bench->gpuBound / bench->count);
+    const struct resizeStats* resize = bench->resize;
+    fprintf(stdout, "Render targets: %s, %.3f ms at startup", options->dynamicRendering ? "dynamic rendering" : "render pass and framebuffers", bench->targetsMs);
+    if(resize && resize->count) fprintf(stdout, ", swapchain rebuild %.3f ms on average (max %.3f) over %u rebuilds", resize->recreateMs / resize->count, resize->recreateMaxMs, resize->count);
+    fprintf(stdout, "\n");
+
+    if(options->benchJson == NULL) return;
+    FILE* fp = fopen(options->benchJson, "w");
+    if(fp == NULL){
+        fprintf(stdout, "ERROR: FILE OPEN FAILED FOR %s\n", options->benchJson);
+        return;
+    }
+    fprintf(fp, "{\n  \"frames\": %llu,\n  \"elapsed_ms\": %.4f,\n  \"fps\": %.4f,\n  \"headless\": %s,\n  \"frames_in_flight\": %u,\n  \"instances\": %u,\n  \"separate_draws\": %s,\n  \"record_threads\": %u,\n",
+        (unsigned long long)bench->count, elapsed, fps, options->headless ? "true" : "false", options->framesInFlight, options->instanceCount,
+        options->separateDraws ? "true" : "false", options->recordThreads);
+    fprintf(fp, "  \"draw_data\": \"%s\",\n", options->drawData == DRAW_DATA_PUSH ? "push" : options->drawData == DRAW_DATA_UNIFORM ? "uniform" : "instanced");
+    fprintf(fp, "  \"present_mode\": \"%s\",\n  \"frame_pacing\": %s,\n", options->headless ? "none" : presentModeName(options->presentMode),
+        options->framePacing ? "true" : "false");
+    fprintf(fp, "  \"rendering\": \"%s\",\n  \"render_targets_ms\": %.4f,\n", options->dynamicRendering ? "dynamic" : "render_pass", bench->targetsMs);
+    if(resize && resize->count) fprintf(fp, "  \"swapchain_rebuilds\": {\"count\": %u, \"mean_ms\": %.4f, \"max_ms\": %.4f},\n",
+        resize->count, resize->recreateMs / resize->count, resize->recreateMaxMs);
+    const struct pipelineRegistry* pipelines = bench->pipelines;
+    fprintf(fp, "  \"pipelines\": {\"threads\": %u, \"compiled\": %u, \"modules\": %u, \"batches\": %u, \"compile_ms\": %.4f, \"max_batch_ms\": %.4f, \"requests\": %llu, \"hits\": %llu, \"placeholder_frames\": %llu},\n",
+        options->pipelineThreads, pipelines->compiled, pipelines->moduleCount, pipelines->batches, pipelines->compileMs, pipelines->maxBatchMs, (unsigned long long)pipelines->requests,
+        (unsigned long long)pipelines->hits, (unsigned long long)bench->placeholderFrames);
+    fprintf(fp, "  \"startup_ms\": %.4f,\n  \"pipeline_ms\": %.4f,\n  \"pipeline_cache\": \"%s\",\n  \"cpu_ms\": {\n", bench->startupMs, bench->pipelineMs,
+        !options->pipelineCachePath ? "disabled" : bench->pipelineCacheLoaded ? "loaded" : "cold");
+    for(int i = 0; i < PHASE_COUNT; i++){
+        if(i == PHASE_GPU) fprintf(fp, "  },\n  \"gpu_ms\": {\n");
+        fprintf(fp, "    \"%s\": {\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n", phaseNames[i],
+            stats[i][0], stats[i][1], stats[i][2], stats[i][3], stats[i][4], stats[i][5], (i + 1 < PHASE_COUNT && i + 1 != PHASE_GPU) ? "," : "");
+    }
+    fprintf(fp, "  },\n");
+    if(bench->latencyCount) fprintf(fp, "  \"latency_ms\": {\"frames\": %llu, \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+        (unsigned long long)bench->latencyCount, latency[0], latency[1], latency[2], latency[3], latency[4], latency[5]);
+    fprintf(fp, "  \"gpu_bound_frames\": %llu\n}\n", (unsigned long long)bench->gpuBound);
+    if(fclose(fp)) fprintf(stdout, "ERROR: FAILURE TO CLOSE FILE %s\n", options->benchJson);
+}
+
+static inline void benchFree(struct benchTimings* bench){
+    for(int i = 0; i < PHASE_COUNT; i++) free(bench->samples[i]);
+}
+
+static inline int parseUint(const char* arg, const char* value, uint32_t* out){
+    char* end = NULL;
+    if(value == NULL) {
+        fprintf(stdout, "ERROR: MISSING VALUE FOR %s\n", arg);
+        return 1;
+    }
+    unsigned long res = strtoul(value, &end, 10);
+    if(*value == '\0' || *end != '\0') {
+        fprintf(stdout, "ERROR: INVALID VALUE %s FOR %s\n", value, arg);
+        return 1;
+    }
+    *out = (uint32_t)res;
+    return 0;
+}
 
+inline int parseOptions(int argc, char** argv, struct appOptions* options){
+    options->framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    options->headless = 0;
+    options->maxFrames = 0;
+    options->bench = 0;
+    options->benchSeconds = 0;
+    options->benchJson = NULL;
+    options->pipelineCachePath = DEFAULT_PIPELINE_CACHE_PATH;
+    options->vertexLayout = VERTEX_LAYOUT_INTERLEAVED;
+    options->indexBits = 0;
+    options->gridSize = 0;
+    options->instanceCount = 1;
+    options->cullMode = CULL_MODE_OFF;
+    options->separateDraws = 0;
+    options->recordThreads = 0;
+    options->cacheCommands = 0;
+    options->presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    options->framePacing = 0;
+    options->device = NULL;
+    options->streamMB = 0;
+    options->streamBudgetKB = DEFAULT_STREAM_BUDGET_KB;
+    options->dynamicRendering = 1;
+    options->rebuildEvery = 0;
+    options->computeBenchMB = 0;
+    options->descriptorMode = DESCRIPTOR_MODE_DYNAMIC;
+    options->bindless = 0;
+    options->drawData = DRAW_DATA_INSTANCED;
+    options->pipelineThreads = DEFAULT_PIPELINE_THREADS;
+    options->pipelineVariants = 0;
+    options->colorMode = COLOR_MODE_SHADED;
+    options->tint = 1;
+    uint32_t warmupFrames = DEFAULT_WARMUP_FRAMES;
+    for(int i = 1; i < argc; i++){
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if(strcmp(argv[i], "--frames-in-flight") == 0){
+            if(parseUint(argv[i], value, &options->framesInFlight)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--headless") == 0){
+            options->headless = 1;
+        } else if(strcmp(argv[i], "--frames") == 0){
+            if(parseUint(argv[i], value, &options->maxFrames)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--bench") == 0){
+            options->bench = 1;
+        } else if(strcmp(argv[i], "--duration") == 0){
+            if(parseUint(argv[i], value, &options->benchSeconds)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--warmup") == 0){
+            if(parseUint(argv[i], value, &warmupFrames)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--pipeline-cache") == 0){
+            if(value == NULL){
+                fprintf(stdout, "ERROR: MISSING VALUE FOR %s\n", argv[i]);
+                return 1;
+            }
+            options->pipelineCachePath = value;
+            i++;
+        } else if(strcmp(argv[i], "--vertex-layout") == 0){
+            if(value != NULL && strcmp(value, "interleaved") == 0) options->vertexLayout = VERTEX_LAYOUT_INTERLEAVED;
+            else if(value != NULL && strcmp(value, "split") == 0) options->vertexLayout = VERTEX_LAYOUT_SPLIT;
+            else {
+                fprintf(stdout, "ERROR: %s MUST BE interleaved OR split\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--index-type") == 0){
+            if(parseUint(argv[i], value, &options->indexBits)) return 1;
+            if(options->indexBits != 16 && options->indexBits != 32){
+                fprintf(stdout, "ERROR: %s MUST BE 16 OR 32\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--grid") == 0){
+            if(parseUint(argv[i], value, &options->gridSize)) return 1;
+            if(options->gridSize > MAX_GRID_SIZE){
+                fprintf(stdout, "ERROR: GRID SIZE MUST BE AT MOST %d\n", MAX_GRID_SIZE);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--instances") == 0){
+            if(parseUint(argv[i], value, &options->instanceCount)) return 1;
+            if(options->instanceCount < 1 || options->instanceCount > MAX_INSTANCE_COUNT){
+                fprintf(stdout, "ERROR: INSTANCE COUNT MUST BE BETWEEN 1 AND %u\n", MAX_INSTANCE_COUNT);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--culling") == 0){
+            if(value != NULL && strcmp(value, "off") == 0) options->cullMode = CULL_MODE_OFF;
+            else if(value != NULL && strcmp(value, "cpu") == 0) options->cullMode = CULL_MODE_CPU;
+            else if(value != NULL && strcmp(value, "gpu") == 0) options->cullMode = CULL_MODE_GPU;
+            else {
+                fprintf(stdout, "ERROR: %s MUST BE off, cpu OR gpu\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--separate-draws") == 0){
+            options->separateDraws = 1;
+        } else if(strcmp(argv[i], "--record-threads") == 0){
+            if(parseUint(argv[i], value, &options->recordThreads)) return 1;
+            if(options->recordThreads > MAX_RECORD_THREADS){
+                fprintf(stdout, "ERROR: RECORD THREADS MUST BE AT MOST %d\n", MAX_RECORD_THREADS);
+                return 1;
+            }
+            // a single instanced draw leaves nothing to split
+            if(options->recordThreads) options->separateDraws = 1;
+            i++;
+        } else if(strcmp(argv[i], "--draw-data") == 0){
+            if(value != NULL && strcmp(value, "instanced") == 0) options->drawData = DRAW_DATA_INSTANCED;
+            else if(value != NULL && strcmp(value, "push") == 0) options->drawData = DRAW_DATA_PUSH;
+            else if(value != NULL && strcmp(value, "uniform") == 0) options->drawData = DRAW_DATA_UNIFORM;
+            else {
+                fprintf(stdout, "ERROR: %s MUST BE instanced, push OR uniform\n", argv[i]);
+                return 1;
+            }
+            // per-draw data means one draw per object
+            if(options->drawData != DRAW_DATA_INSTANCED) options->separateDraws = 1;
+            i++;
+        } else if(strcmp(argv[i], "--cache-commands") == 0){
+            options->cacheCommands = 1;
+        } else if(strcmp(argv[i], "--present-mode") == 0){
+            uint32_t mode = 0;
+            while(value != NULL && mode < PRESENT_MODE_COUNT && strcmp(value, presentModeNames[mode].name)) mode++;
+            if(value == NULL || mode == PRESENT_MODE_COUNT){
+                fprintf(stdout, "ERROR: %s MUST BE fifo, fifo-relaxed, mailbox OR immediate\n", argv[i]);
+                return 1;
+            }
+            options->presentMode = presentModeNames[mode].mode;
+            i++;
+        } else if(strcmp(argv[i], "--device") == 0){
+            if(value == NULL){
+                fprintf(stdout, "ERROR: MISSING VALUE FOR %s\n", argv[i]);
+                return 1;
+            }
+            options->device = value;
+            i++;
+        } else if(strcmp(argv[i], "--stream") == 0){
+            if(parseUint(argv[i], value, &options->streamMB)) return 1;
+            if(options->streamMB > MAX_STREAM_MB){
+                fprintf(stdout, "ERROR: STREAMED SCENE MUST BE AT MOST %d MB\n", MAX_STREAM_MB);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--stream-budget") == 0){
+            if(parseUint(argv[i], value, &options->streamBudgetKB)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--low-latency") == 0){
+            options->framePacing = 1;
+        } else if(strcmp(argv[i], "--no-dynamic-rendering") == 0){
+            options->dynamicRendering = 0;
+        } else if(strcmp(argv[i], "--rebuild-every") == 0){
+            if(parseUint(argv[i], value, &options->rebuildEvery)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--compute-bench") == 0){
+            if(parseUint(argv[i], value, &options->computeBenchMB)) return 1;
+            if(options->computeBenchMB > MAX_COMPUTE_BENCH_MB){
+                fprintf(stdout, "ERROR: COMPUTE BENCHMARK MUST BE AT MOST %d MB\n", MAX_COMPUTE_BENCH_MB);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--descriptor-updates") == 0){
+            options->descriptorMode = DESCRIPTOR_MODE_UPDATE;
+        } else if(strcmp(argv[i], "--bindless") == 0){
+            options->bindless = 1;
+        } else if(strcmp(argv[i], "--pipeline-threads") == 0){
+            if(parseUint(argv[i], value, &options->pipelineThreads)) return 1;
+            if(options->pipelineThreads > MAX_PIPELINE_THREADS){
+                fprintf(stdout, "ERROR: PIPELINE THREADS MUST BE AT MOST %d\n", MAX_PIPELINE_THREADS);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--pipeline-variants") == 0){
+            if(parseUint(argv[i], value, &options->pipelineVariants)) return 1;
+            i++;
+        } else if(strcmp(argv[i], "--color-mode") == 0){
+            if(value != NULL && strcmp(value, "shaded") == 0) options->colorMode = COLOR_MODE_SHADED;
+            else if(value != NULL && strcmp(value, "object") == 0) options->colorMode = COLOR_MODE_OBJECT;
+            else if(value != NULL && strcmp(value, "vertex") == 0) options->colorMode = COLOR_MODE_VERTEX;
+            else {
+                fprintf(stdout, "ERROR: %s MUST BE shaded, object OR vertex\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if(strcmp(argv[i], "--no-tint") == 0){
+            options->tint = 0;
+        } else if(strcmp(argv[i], "--no-pipeline-cache") == 0){
+            options->pipelineCachePath = NULL;
+        } else if(strcmp(argv[i], "--bench-json") == 0){
+            if(value == NULL){
+                fprintf(stdout, "ERROR: MISSING VALUE FOR %s\n", argv[i]);
+                return 1;
+            }
+            options->benchJson = value;
+            options->bench = 1;
+            i++;
+        } else {
+            fprintf(stdout, "ERROR: UNKNOWN OPTION %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(options->framesInFlight < 1 || options->framesInFlight > MAX_FRAMES_IN_FLIGHT){
+        fprintf(stdout, "ERROR: FRAMES IN FLIGHT MUST BE BETWEEN 1 AND %d\n", MAX_FRAMES_IN_FLIGHT);
+        return 1;
+    }
+    // warmup frames only exist to be left out of the measurements
+    options->warmupFrames = options->bench ? warmupFrames : 0;
+    if(options->headless && options->rebuildEvery){
+        fprintf(stdout, "WARNING: THERE IS NO SWAPCHAIN TO REBUILD WHEN HEADLESS, --rebuild-every IGNORED\n");
+        options->rebuildEvery = 0;
+    }
+    // a cached recording would keep binding a set from a pool that has been reset since
+    if(options->cacheCommands && options->descriptorMode == DESCRIPTOR_MODE_UPDATE){
+        fprintf(stdout, "WARNING: SETS WRITTEN EVERY FRAME CAN NOT BE CACHED, --cache-commands IGNORED\n");
+        options->cacheCommands = 0;
+    }
+    // the indirect draws written by the culling pass read the instance stream
+    if(options->drawData != DRAW_DATA_INSTANCED && options->cullMode == CULL_MODE_GPU){
+        fprintf(stdout, "WARNING: GPU CULLING DRAWS FROM THE INSTANCE STREAM, --draw-data IGNORED\n");
+        options->drawData = DRAW_DATA_INSTANCED;
+    }
+    // pushed values are baked into the recording, so a cached one would freeze the animation
+    if(options->cacheCommands && options->drawData == DRAW_DATA_PUSH){
+        fprintf(stdout, "WARNING: PUSH CONSTANTS ARE RECORDED WITH THEIR VALUES, --cache-commands IGNORED\n");
+        options->cacheCommands = 0;
+    }
+    // there is no window to close so headless runs always need an end
+    if(options->headless && !options->maxFrames && !options->benchSeconds) options->maxFrames = DEFAULT_HEADLESS_FRAMES;
     return 0;
 }
 
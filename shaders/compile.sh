@@ -1,4 +1,15 @@
 #! /bin/sh
+set -e
 
 glslc shader.vert -o vert.spv
-glslc shader.frag -o frag.spv
\ No newline at end of file
+spirv-val vert.spv
+glslc shader.frag -o frag.spv
+spirv-val frag.spv
+glslc cull.comp -o cull.spv
+spirv-val cull.spv
+glslc reduce.comp -o reduce.spv
+spirv-val reduce.spv
+glslc draw.vert -o draw.spv
+spirv-val draw.spv
+glslc draw_uniform.vert -o draw_uniform.spv
+spirv-val draw_uniform.spv
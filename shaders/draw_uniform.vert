@@ -0,0 +1,31 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// specialization constants, set per pipeline variant so the driver can drop the branches not taken
+layout(constant_id = 0) const uint colorMode = 0; // COLOR_MODE_*, 0 vertex times object color, 1 object color, 2 vertex color
+layout(constant_id = 1) const bool applyTint = true; // multiply by the frame's tint
+
+layout(set = 0, binding = 0) uniform Frame {
+    vec4 tint;
+} frame;
+
+// struct drawConstants, bound at a dynamic offset into the frame's arena before every draw
+// the fallback for devices whose push constant space is too small for it
+layout(set = 2, binding = 0) uniform Draw {
+    vec3 transform; // xy offset, z uniform scale
+    uint objectId;
+    vec4 color;
+} draw;
+
+void main() {
+    gl_Position = vec4(inPosition * draw.transform.z + draw.transform.xy, 0.0, 1.0);
+    vec3 color = inColor * draw.color.rgb;
+    if(colorMode == 1) color = draw.color.rgb;
+    else if(colorMode == 2) color = inColor;
+    if(applyTint) color *= frame.tint.rgb;
+    fragColor = color;
+}
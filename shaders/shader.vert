@@ -1,20 +1,26 @@
 #version 450
 
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 instanceTransform; // xy offset, z uniform scale
+layout(location = 3) in vec3 instanceColor;
+
 layout(location = 0) out vec3 fragColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// specialization constants, set per pipeline variant so the driver can drop the branches not taken
+layout(constant_id = 0) const uint colorMode = 0; // COLOR_MODE_*, 0 vertex times object color, 1 object color, 2 vertex color
+layout(constant_id = 1) const bool applyTint = true; // multiply by the frame's tint
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// struct frameUniforms, bound at a dynamic offset into the frame's arena
+layout(set = 0, binding = 0) uniform Frame {
+    vec4 tint;
+} frame;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    gl_Position = vec4(inPosition * instanceTransform.z + instanceTransform.xy, 0.0, 1.0);
+    vec3 color = inColor * instanceColor;
+    if(colorMode == 1) color = instanceColor;
+    else if(colorMode == 2) color = inColor;
+    if(applyTint) color *= frame.tint.rgb;
+    fragColor = color;
+}